@@ -35,9 +35,12 @@ namespace microbit_dal_ext_kit {
 		- ExtKitMotorsPT.h
 		- ExtKitNeoPixel.h
 		- ExtKitPeriodicObserver.h
+		- ExtKitRadioLoopback.h
 		- ExtKitRemoteState.h
+		- ExtKitRemoteStateTyped.h
 		- ExtKitSerialDebugger.h
 		- ExtKitSonar.h
+		- ExtKitTimeSync.h
 		- ExtKitTouchPiano.h
 		- ExtKitZipHalo.h
 
@@ -64,6 +67,8 @@ namespace microbit_dal_ext_kit {
 		- ExtKitStatistics.h
 		- ExtKitString.h
 		- ExtKitTime.h
+		- ExtKitTrace.h
+		- ExtKitWs2812.h
 
 	# Others
 		- ExtKit_Common.h
@@ -111,7 +116,9 @@ namespace microbit_dal_ext_kit {
 #include "ExtKitPeriodicObserver.h"
 #include "ExtKitPianoKey.h"
 #include "ExtKitRadio.h"
+#include "ExtKitRadioLoopback.h"
 #include "ExtKitRemoteState.h"
+#include "ExtKitRemoteStateTyped.h"
 #include "ExtKitRequest.h"
 #include "ExtKitSerial.h"
 #include "ExtKitSerialDebugger.h"
@@ -120,7 +127,10 @@ namespace microbit_dal_ext_kit {
 #include "ExtKitStatistics.h"
 #include "ExtKitString.h"
 #include "ExtKitTime.h"
+#include "ExtKitTimeSync.h"
 #include "ExtKitTouchPiano.h"
+#include "ExtKitTrace.h"
+#include "ExtKitWs2812.h"
 #include "ExtKitZipHalo.h"
 
 #endif	// EXT_KIT_H
@@ -93,6 +93,9 @@ public:
 	/// Constructor with hsv color components
 	Color(uint16_t /* 360 */ whole, uint16_t /* hue level (e.g., 0-359) */ h, uint8_t /* saturation level */ s, uint8_t /* value (brightness) level */ v);
 
+	/// Create a color from hsv color components using a 256-step hue circle. No division is used.
+	static Color fromHsv(uint8_t /* hue level (0-255) */ h, uint8_t /* saturation level */ s = 0xff, uint8_t /* value (brightness) level */ v = 0xff);
+
 	/// Get red color component of rgb
 	inline uint8_t /* red level */ r() const {
 		return (uint8_t) (mRGB >> 16);
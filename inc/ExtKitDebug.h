@@ -72,6 +72,9 @@ inline void debug_sendLine(const char* s1, const char* s2, const char* s3, const
 	debug_sendLine(withDebugPrefix, suffix, s1, s2, s3, s4, s5);
 }
 
+/// Send a line formatted with string::format() to the debugger without heap allocation. The line is truncated to 127 characters.
+void debug_sendFormat(const char* fmt, ...) __attribute__ ((format (printf, 1, 2)));
+
 /// Send a memory dump block to the debugger
 void debug_sendMemoryDump(const void* buffer, size_t length);
 
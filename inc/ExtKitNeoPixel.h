@@ -12,37 +12,45 @@
 #ifndef EXT_KIT_NEO_PIXEL_H
 #define EXT_KIT_NEO_PIXEL_H
 
+#include "ManagedString.h"
+
 #include "ExtKitColor.h"
 #include "ExtKitComponent.h"
 #include "ExtKitDirection.h"
+#include "ExtKitNode.h"
 
 class MicroBitPin;
 
 namespace microbit_dal_ext_kit {
 
-/// An ext-kit Component which provides the support for a generic LED Strip using WS2812B modules also known as %NeoPixel
-class NeoPixel : public Component
+class NeoPixel;
+
+/// A view over a sub-range of a NeoPixel strip with its own color mode and max brightness
+/**
+	The max brightness of a segment caps the max brightness of the strip for its range. The lower of the two applies.
+	Segments must be destroyed before their strip.
+	In palette mode, a segment uses a range of the palette, which is the whole palette by default.
+	The color map modes and the rainbow modes rewrite the palette colors in the range, so segments using them should have disjoint ranges set by setPaletteRange().
+	The color setters pick the nearest palette color in the range.
+*/
+class NeoPixelSegment
 {
+	friend class NeoPixel;
+
 public:
 	/// Max brightness value in percent
 	typedef int	MaxBrightness;
 
-	/// The lowest value for max brightness
-	static const MaxBrightness kMaxBrightnessLowest = 5;
-
-	/// No limit value for max brightness
-	static const MaxBrightness kMaxBrightnessNoLimit = 100;
-
-	/// Constructor with a digital port and a led count
-	NeoPixel(const char* name, MicroBitPin& ledPort, int ledCount);
+	/// Constructor with a strip, the index of the first led module and a led count
+	NeoPixelSegment(NeoPixel& strip, int first, int ledCount);
 
 	/// Destructor
-	~NeoPixel();
+	~NeoPixelSegment();
 
-	/// Apply the current colors and max brightness to the LED strip
+	/// Apply the current colors of the strip, including this segment, to the LED strip
 	void show();
 
-	/// Set max brightness value in percent. Call show() to apply the change.
+	/// Set max brightness value in percent, which caps the max brightness of the strip for this segment. Call show() to apply the change.
 	void setMaxBrightness(MaxBrightness limit);
 
 	/// Change max brightness value in percent. Call show() to apply the change.
@@ -51,18 +59,51 @@ public:
 	/// Get max brightness value in percent
 	MaxBrightness maxBrightness();
 
+	/// Get the strip
+	inline NeoPixel& strip() {
+		return mStrip;
+	}
+
+	/// Get the index of the first led module on the strip
+	inline int first() {
+		return mFirst;
+	}
+
+	/// Get the led count
+	inline int ledCount() {
+		return mLedCount;
+	}
+
+	/// Set the range of the palette used by this segment. Valid only in palette mode. The range must not overlap the range set for another segment.
+	void setPaletteRange(int first, int count);
+
 	/// Fill all led modules with a color. Call show() to apply the change.
 	void fillColor(Color color);
 
 	/// Fill all led modules with a rainbow color pattern. Call show() to apply the change.
 	void fillColorWithRainbow();
 
+	/// Fill led modules in a range with a hue gradient in one pass. Call show() to apply the change.
+	/**
+		`startHue` and `hueStep` are in 1/256 steps of the 256-step hue circle used by Color::fromHsv(), i.e., 0x10000 is one full turn.
+	*/
+	void fillColorWithHueGradient(int index, int count, uint16_t startHue, uint16_t hueStep, uint8_t s = 0xff, uint8_t v = 0xff);
+
 	/// Set a color to a led module. Call show() to apply the change.
 	void setColor(int index, Color color);
 
 	/// Get a color from a led module. Call show() to apply the change.
 	Color color(int index);
 
+	/// Fill all led modules with a palette index, which is an index of the whole palette. Valid only in palette mode. Call show() to apply the change.
+	void fillColorIndex(uint8_t paletteIndex);
+
+	/// Set a palette index, which is an index of the whole palette, to a led module. Valid only in palette mode. Call show() to apply the change.
+	void setColorIndex(int index, uint8_t paletteIndex);
+
+	/// Get a palette index from a led module. Valid only in palette mode.
+	uint8_t colorIndex(int index);
+
 	/// Rotate led modules left. Call show() to apply the change.
 	void rotateLeft();
 
@@ -85,8 +126,8 @@ public:
 	void fillColorWithFocusDirection(Direction focusDirection);
 
 protected:
-	/// Inherited
-	/* Component */ void doHandleComponentAction(Action action);
+	/// Constructor for the segment covering the whole strip. The segment is not attached to the strip.
+	NeoPixelSegment(NeoPixel& strip, int ledCount);
 
 	/// Fill Color Directly
 	void fillColorDirectly(Color color);
@@ -94,12 +135,33 @@ protected:
 	/// Set Color Directly
 	void setColorDirectly(int index, Color color);
 
+	/// Fill Color With Hue Gradient Directly
+	void fillColorWithHueGradientDirectly(int index, int count, uint16_t startHue, uint16_t hueStep, uint8_t s, uint8_t v);
+
+	/// Fill Color Index Directly
+	void fillColorIndexDirectly(uint8_t paletteIndex);
+
+	/// Set Color Index Directly
+	void setColorIndexDirectly(int index, uint8_t paletteIndex);
+
+	/// Fill Color Map Entry Directly. Uses a palette index in palette mode or a color otherwise.
+	void fillColorMapEntryDirectly(int entry);
+
+	/// Set Color Map Entry Directly. Uses a palette index in palette mode or a color otherwise.
+	void setColorMapEntryDirectly(int index, int entry);
+
+	/// Fill Rainbow Directly with hue 0 at the offset
+	void fillRainbowDirectly(int offset);
+
+	/// Get the number of palette colors used by this segment
+	int paletteCount();
+
+	/// Get the palette index of the nearest color in the palette range
+	uint8_t paletteIndexForColor(Color color);
+
 	/// Fill Color Using Color Mode
 	void fillColorUsingColorMode();
 
-	/// Dump Pin
-	void debug_dumpPin(MicroBitPin* pin);
-
 	/// Color Mode
 	enum ColorMode {
 		kManual,				///< Manual Color (No Mode)
@@ -108,24 +170,27 @@ protected:
 		kRainbowMapForFocus		///< Use Rainbow Map for Focus
 	};
 
-	/// Led Port
-	MicroBitPin&	mLedPort;
+	/// Strip
+	NeoPixel&		mStrip;
+
+	/// Index of the first led module on the strip
+	int				mFirst;
 
 	/// Led Count
 	int				mLedCount;
 
-	/// Led Hue Unit
-	int 			mLedHueUnit;
-
-	/// Led Bufer Length
-	int				mLedBufferLength;
-
-	/// Led Bufer
-	uint8_t*		mLedBuffer;
+	/// Attached to the strip
+	bool			mAttached;
 
 	/// Max Brightness
 	MaxBrightness	mMaxBrightness;
 
+	/// First palette index used by this segment
+	int				mPaletteFirst;
+
+	/// Number of palette colors used by this segment. 0 means the whole palette.
+	int				mPaletteCount;
+
 	/// Color Mode
 	ColorMode		mColorMode;
 
@@ -138,8 +203,270 @@ protected:
 	/// Focus Direction for Color Mode `kColorMapForFocus` or `kRainbowMapForFocus`
 	Direction		mFocusDirection;
 
+};	// NeoPixelSegment
+
+/// An ext-kit Component which provides the support for a generic LED Strip using WS2812B modules also known as %NeoPixel
+class NeoPixel : public Component
+{
+	friend class NeoPixelSegment;
+	friend class NeoPixelGroup;
+
+public:
+	/// Max brightness value in percent
+	typedef NeoPixelSegment::MaxBrightness	MaxBrightness;
+
+	/// The lowest value for max brightness
+	static const MaxBrightness kMaxBrightnessLowest = 5;
+
+	/// No limit value for max brightness
+	static const MaxBrightness kMaxBrightnessNoLimit = 100;
+
+	/// Palette Mode
+	enum PaletteMode {
+		kPaletteNone	= 0,	///< No palette. Each led module stores a 3-byte color.
+		kPalette4Bits	= 4,	///< Each led module stores a 4-bit palette index. Up to 16 palette colors.
+		kPalette8Bits	= 8		///< Each led module stores an 8-bit palette index. Up to 256 palette colors.
+	};
+
+	/// Constructor with a digital port, a led count and an optional palette mode
+	/**
+		In palette mode, the colors are expanded from the palette on the fly during show().
+		`paletteSize` 0 means the max size for the palette mode.
+		The color map modes use palette indices 0-3 and the rainbow modes use the whole palette. See NeoPixelSegment for segments.
+	*/
+	NeoPixel(const char* name, MicroBitPin& ledPort, int ledCount, PaletteMode paletteMode = kPaletteNone, int paletteSize = 0);
+
+	/// Destructor. All segments must be destroyed and the strip must be removed from all groups before.
+	~NeoPixel();
+
+	/// Apply the current colors and max brightness to the LED strip
+	void show();
+
+	/// Set max brightness value in percent. Call show() to apply the change.
+	void setMaxBrightness(MaxBrightness limit);
+
+	/// Change max brightness value in percent. Call show() to apply the change.
+	void changeMaxBrightness(int offset);
+
+	/// Get max brightness value in percent
+	MaxBrightness maxBrightness();
+
+	/// Set the current model used for the current budget. Call show() to apply the change.
+	void setCurrentModel(uint16_t microAmperesPerStep, uint16_t idleMicroAmperesPerLed);
+
+	/// Set the current budget in milliamperes for the whole strip. 0 means no limit. Call show() to apply the change.
+	/**
+		The whole frame is scaled down if the estimated current exceeds the budget.
+		The estimated current is also reported to Statistics.
+	*/
+	void setCurrentBudget(uint16_t milliAmperes);
+
+	/// Get the estimated current in milliamperes of the frame applied by the last show()
+	uint16_t estimatedCurrent();
+
+	/// Get the led count
+	inline int ledCount() {
+		return mLedCount;
+	}
+
+	/// Get the palette size. 0 means no palette.
+	inline int paletteSize() {
+		return mPaletteSize;
+	}
+
+	/// Set a palette color. Valid only in palette mode. Call show() to apply the change.
+	void setPaletteColor(int paletteIndex, Color color);
+
+	/// Get a palette color. Valid only in palette mode.
+	Color paletteColor(int paletteIndex);
+
+	/// Rotate palette colors left for color cycling. Valid only in palette mode. Call show() to apply the change.
+	void rotatePaletteLeft();
+
+	/// Rotate palette colors right for color cycling. Valid only in palette mode. Call show() to apply the change.
+	void rotatePaletteRight();
+
+	/// Fill all led modules with a palette index. Valid only in palette mode. Call show() to apply the change.
+	void fillColorIndex(uint8_t paletteIndex);
+
+	/// Set a palette index to a led module. Valid only in palette mode. Call show() to apply the change.
+	void setColorIndex(int index, uint8_t paletteIndex);
+
+	/// Get a palette index from a led module. Valid only in palette mode.
+	uint8_t colorIndex(int index);
+
+	/// Fill all led modules with a color. Call show() to apply the change.
+	void fillColor(Color color);
+
+	/// Fill all led modules with a rainbow color pattern. Call show() to apply the change.
+	void fillColorWithRainbow();
+
+	/// Fill led modules in a range with a hue gradient in one pass. Call show() to apply the change. See NeoPixelSegment::fillColorWithHueGradient().
+	void fillColorWithHueGradient(int index, int count, uint16_t startHue, uint16_t hueStep, uint8_t s = 0xff, uint8_t v = 0xff);
+
+	/// Set a color to a led module. Call show() to apply the change.
+	void setColor(int index, Color color);
+
+	/// Get a color from a led module. Call show() to apply the change.
+	Color color(int index);
+
+	/// Rotate led modules left. Call show() to apply the change.
+	void rotateLeft();
+
+	/// Rotate led modules right. Call show() to apply the change.
+	void rotateRight();
+
+	/// Set a color map for a indicator. Call show() to apply the change.
+	void setColorMapForIndicator(Color colorOff, Color colorOn);
+
+	/// Fill all led modules using a indicator pattern
+	void fillColorWithIndicatorPattern(uint32_t indicatorPattern);
+
+	/// Set a color map for a focus. Call show() to apply the change.
+	void setColorMapForFocus(Color colorOff, Color colorOn1, Color colorOn2, Color colorOn3);
+
+	/// Set a rainbow map for a focus. Call show() to apply the change
+	void setRainbowMapForFocus();
+
+	/// Fill all led modules using a focus direction
+	void fillColorWithFocusDirection(Direction focusDirection);
+
+	/// Send benchmark results of the rainbow fill to the debugger. The colors are overwritten. Not available in palette mode. Call show() to apply the change.
+	void debug_sendBenchmark(int repeatCount = 100);
+
+protected:
+	/// Inherited
+	/* Component */ void doHandleComponentAction(Action action);
+
+	/// Attach Segment
+	void attachSegment(NeoPixelSegment& segment);
+
+	/// Detach Segment
+	void detachSegment(NeoPixelSegment& segment);
+
+	/// Prepare the output buffer by applying max brightness to the current colors
+	void prepareOutput();
+
+	/// Prepare the output buffer for a range of led modules. Returns the sum of the output levels of the range.
+	uint32_t prepareOutput(int first, int ledCount, MaxBrightness maxBrightness, uint32_t* /* OUT */ replacedLevel = 0);
+
+	/// Scale the output buffer down by a factor in 1/256
+	void scaleOutput(uint16_t factor);
+
+	/// Send the output buffer to the LED strip. IRQ should be disabled by the caller.
+	void sendOutput();
+
+	/// Get the palette index at a led module
+	uint8_t colorIndexAt(int ledIndex);
+
+	/// Set a palette index at a led module
+	void setColorIndexAt(int ledIndex, uint8_t paletteIndex);
+
+	/// Dump Pin
+	void debug_dumpPin(MicroBitPin* pin);
+
+	/// Segment Record
+	struct SegmentRecord : public Node
+	{
+	public:
+		/// Constructor
+		SegmentRecord(NeoPixelSegment& segment);
+
+		/// Segment
+		NeoPixelSegment&	segment;
+
+	};	// SegmentRecord
+
+	/// Led Port
+	MicroBitPin&	mLedPort;
+
+	/// Led Count
+	int				mLedCount;
+
+	/// Palette Mode
+	PaletteMode		mPaletteMode;
+
+	/// Palette Size. 0 means no palette.
+	int				mPaletteSize;
+
+	/// Led Bufer Length
+	int				mLedBufferLength;
+
+	/// Led Bufer. Colors or palette indices.
+	uint8_t*		mLedBuffer;
+
+	/// Palette. Colors in GRB order. 0 means no palette.
+	uint8_t*		mPalette;
+
+	/// Output Bufer Length
+	int				mOutputBufferLength;
+
+	/// Output Bufer. Colors with brightness control in GRB order.
+	uint8_t*		mOutputBuffer;
+
+	/// Number of groups including this strip
+	int				mGroupCount;
+
+	/// Current per channel step in microamperes
+	uint16_t		mMicroAmperesPerStep;
+
+	/// Idle current per led module in microamperes
+	uint16_t		mIdleMicroAmperesPerLed;
+
+	/// Current budget in milliamperes. 0 means no limit.
+	uint16_t		mCurrentBudget;
+
+	/// Estimated current in milliamperes
+	uint16_t		mEstimatedCurrent;
+
+	/// Statistics Key String for Estimated Current
+	ManagedString	mStatisticsCurrent;
+
+	/// Statistics Key String for Current Limited Count
+	ManagedString	mStatisticsCurrentLimited;
+
+	/// Segment covering the whole strip, which also holds max brightness of the strip
+	NeoPixelSegment	mWholeSegment;
+
+	/// Root Node for SegmentRecord
+	RootForDynamicNodes	mSegmentRoot;
+
 };	// NeoPixel
 
+/// A group of NeoPixel strips transmitted back-to-back in one IRQ-disabled window
+class NeoPixelGroup
+{
+public:
+	/// Destructor
+	~NeoPixelGroup();
+
+	/// Add a strip
+	void addStrip(NeoPixel& strip);
+
+	/// Remove a strip
+	void removeStrip(NeoPixel& strip);
+
+	/// Apply the current colors and max brightness to all LED strips in the group
+	void show();
+
+private:
+	/// Strip Record
+	struct StripRecord : public Node
+	{
+	public:
+		/// Constructor
+		StripRecord(NeoPixel& strip);
+
+		/// Strip
+		NeoPixel&	strip;
+
+	};	// StripRecord
+
+	/// Root Node for StripRecord
+	RootForDynamicNodes	mRoot;
+
+};	// NeoPixelGroup
+
 }	// microbit_dal_ext_kit
 
 #endif	// EXT_KIT_NEO_PIXEL_H
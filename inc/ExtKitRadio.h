@@ -30,6 +30,138 @@ void send(const ManagedString& command);
 /// Recv
 ManagedString /* received */ recv();
 
+/// Send a binary datagram without heap allocation
+void send(const uint8_t* buffer, int length);
+
+/// Priority Class for the transmit queue
+enum Priority {
+	kPriorityLow,		///< Low-value datagrams such as telemetry
+	kPriorityNormal,	///< Ordinary datagrams
+	kPriorityHigh,		///< Time-critical datagrams such as commands
+	kPriorityCount		///< Number of priority classes
+};
+
+/// Send a binary datagram through the transmit queue
+/**
+	The datagram is copied into a small bounded queue and sent by a single drain fiber, higher priority first and in order within a class.
+	A datagram not sent within `lifetime` milliseconds is dropped as stale. 0 means no deadline.
+	If the queue is full, the oldest datagram in the lowest class not higher than `priority` is dropped to make room. Otherwise the new one is dropped.
+	Returns false if the new datagram is dropped. The queue latency and the drops are reported to Statistics for each class.
+*/
+bool /* queued */ send(const uint8_t* buffer, int length, Priority priority, uint16_t lifetime = 0);
+
+/// Wait until the transmit queue has a free entry, so that a burst of datagrams does not evict its own earlier datagrams. Returns immediately if the fiber scheduler is not running.
+void waitForTxQueue();
+
+/// Set the contention control of the transmit queue. 0 for `windowMax` (default) disables it.
+/**
+	Each datagram sent from the transmit queue is delayed by a random jitter within the window, so that the nodes sending on the same periodic boundaries do not collide in lock-step.
+	The window starts at `windowMin` milliseconds, doubles for each loss reported by reportLoss() up to `windowMax`, and halves for each delivery reported by reportDelivery().
+	If `slotCount` is not 0, each datagram is also deferred to the slot of this node in a frame of `slotCount` slots of `slotLength` milliseconds.
+	The slot is derived from the serial number, and the frame is aligned with `time::networkTime()`. The jitter is limited to the half of a slot then.
+	Only the datagrams sent through the transmit queue are controlled. The text commands sent by send(const ManagedString&), e.g., Remote %State in the text wire format, and the binary datagrams sent by send(const uint8_t*, int) bypass it.
+*/
+void setContention(uint16_t windowMin, uint16_t windowMax, uint8_t slotCount = 0, uint16_t slotLength = 0);
+
+/// Check whether the contention control is enabled or not
+bool isContentionEnabled();
+
+/// Report a datagram lost, which widens the jitter window
+void reportLoss();
+
+/// Report a datagram delivered, which narrows the jitter window
+void reportDelivery();
+
+/// Get the delay in milliseconds before sending a datagram under the contention control
+uint32_t /* milliseconds */ contentionDelay();
+
+/// Contention Control of a node, which is the jitter window with the exponential backoff and the slotted schedule
+/**
+	The transmit queue uses the one set by setContention() for this device. The contention benchmark uses one for each simulated node.
+*/
+struct ContentionControl
+{
+	/// Constructor, which disables the contention control
+	ContentionControl();
+
+	/// Set the parameters. See setContention().
+	void set(uint16_t windowMin, uint16_t windowMax, uint8_t slotCount, uint16_t slotLength);
+
+	/// Widen the jitter window for a loss. Returns false if the window is not changed.
+	bool widen();
+
+	/// Narrow the jitter window for a delivery. Returns false if the window is not changed.
+	bool narrow();
+
+	/// Get the delay in milliseconds before sending a datagram from the node with `serialNumber` at the network time `now`
+	uint32_t /* milliseconds */ delay(uint32_t serialNumber, uint32_t /* network time */ now) const;
+
+	/// Min Jitter Window in milliseconds
+	uint16_t	windowMin;
+
+	/// Max Jitter Window in milliseconds. 0 means the contention control is disabled.
+	uint16_t	windowMax;
+
+	/// Jitter Window in milliseconds
+	uint16_t	window;
+
+	/// Slot Count. 0 means no slotted schedule.
+	uint8_t		slotCount;
+
+	/// Slot Length in milliseconds
+	uint16_t	slotLength;
+
+};	// ContentionControl
+
+/// Recv a binary datagram into `buffer` without heap allocation. Returns the received length or 0 if no data is available.
+int /* length */ recv(uint8_t* /* OUT */ buffer, int bufferSize);
+
+/// Transport Protocol, which carries datagrams in place of `MicroBitRadio`
+/* interface */ class TransportProtocol
+{
+public:
+	/// Prepare the transport
+	virtual /* to be implemented */ void prepareTransport() = 0;
+
+	/// Send a datagram
+	virtual /* to be implemented */ void sendDatagram(const uint8_t* datagram, int length) = 0;
+
+	/// Recv a datagram into `buffer`. Returns the received length or 0 if no data is available.
+	virtual /* to be implemented */ int /* length */ recvDatagram(uint8_t* /* OUT */ buffer, int bufferSize) = 0;
+
+};	// TransportProtocol
+
+/// Set the transport used by `prepare()`, `send()`, `recv()` and `listen()`. 0 (default) means `MicroBitRadio`.
+void setTransport(TransportProtocol* transport);
+
+/// Get the transport. 0 means `MicroBitRadio`.
+TransportProtocol* transport();
+
+/// Notify that datagrams are available from the transport, which drains them to the listening protocols
+void notifyTransportDatagrams();
+
+/// Datagram Protocol
+/* interface */ class DatagramProtocol
+{
+public:
+	/// Handle a radio datagram received. `datagram` is a read-only view which is valid only during the call.
+	virtual /* to be implemented */ void handleRadioDatagram(const uint8_t* datagram, int length) = 0;
+
+};	// DatagramProtocol
+
+/// Listen to radio datagrams
+/**
+	Every queued datagram is drained per `MICROBIT_RADIO_EVT_DATAGRAM` event and passed to every listening protocol without copying.
+	The queue depth and the number of times the queue is found full are reported to Statistics.
+*/
+void listen(DatagramProtocol& protocol);
+
+/// Ignore radio datagrams
+void ignore(DatagramProtocol& protocol);
+
+/// Get the RSSI of the datagram being handled, as reported by `PacketBuffer::getRSSI()`. Valid only during `DatagramProtocol::handleRadioDatagram()`. Returns 0 if unknown.
+int lastRssi();
+
 }	// radio
 }	// microbit_dal_ext_kit
 
@@ -0,0 +1,136 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Radio Loopback component
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#ifndef EXT_KIT_RADIO_LOOPBACK_H
+#define EXT_KIT_RADIO_LOOPBACK_H
+
+#include "ExtKitComponent.h"
+#include "ExtKitPeriodicObserver.h"
+#include "ExtKitRadio.h"
+#include "ExtKitTime.h"
+
+namespace microbit_dal_ext_kit {
+namespace radio {
+
+/// An ext-kit Component which provides an in-process loopback transport in place of `MicroBitRadio`
+/**
+	Every datagram sent is delivered back to the protocols listening with `radio::listen()`, so that a Transmitter and a Receiver work in one device without radio.
+	The loss rate, the latency and the reordering rate are configurable. The latency is rounded up to 20 milliseconds.
+*/
+class LoopbackTransport : public Component, TransportProtocol, PeriodicObserver::HandlerProtocol
+{
+public:
+	/// Get global instance. Valid only after an instance of class `LoopbackTransport` is created.
+	static LoopbackTransport& global();
+
+	/// Constructor
+	LoopbackTransport();
+
+	/// Destructor
+	~LoopbackTransport();
+
+	/// Set the loss rate in per mille
+	void setLossRate(uint16_t perMille);
+
+	/// Get the loss rate in per mille
+	uint16_t lossRate();
+
+	/// Set the latency and its random jitter in milliseconds
+	void setLatency(uint16_t latency, uint16_t jitter = 0);
+
+	/// Set the reordering rate in per mille. A reordered datagram is delayed so that the following datagrams overtake it.
+	void setReorderRate(uint16_t perMille);
+
+	/// Get the number of datagrams sent
+	uint16_t sentCount();
+
+	/// Get the number of datagrams lost
+	uint16_t lostCount();
+
+protected:
+	/// Inherited
+	/* Component */ void doHandleComponentAction(Action action);
+
+private:
+	/// Queue Entry
+	struct QueueEntry
+	{
+		/// Datagram
+		uint8_t				datagram[MICROBIT_RADIO_MAX_PACKET_SIZE];
+
+		/// Datagram Length. 0 means the entry is free.
+		uint8_t				length;
+
+		/// Time when the datagram is delivered
+		time::SystemTime	dueTime;
+
+	};	// QueueEntry
+
+	/// Queue Size
+	static const int kQueueSize = 8;
+
+	/// Inherited
+	/* TransportProtocol */ void prepareTransport();
+
+	/// Inherited
+	/* TransportProtocol */ void sendDatagram(const uint8_t* datagram, int length);
+
+	/// Inherited
+	/* TransportProtocol */ int /* length */ recvDatagram(uint8_t* /* OUT */ buffer, int bufferSize);
+
+	/// Inherited
+	/* PeriodicObserver::HandlerProtocol */ void handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit);
+
+	/// Global instance
+	static LoopbackTransport*	sGlobal;
+
+	/// Queue
+	QueueEntry		mQueue[kQueueSize];
+
+	/// Loss Rate in per mille
+	uint16_t		mLossRate;
+
+	/// Latency in milliseconds
+	uint16_t		mLatency;
+
+	/// Latency Jitter in milliseconds
+	uint16_t		mJitter;
+
+	/// Reordering Rate in per mille
+	uint16_t		mReorderRate;
+
+	/// Number of datagrams sent
+	uint16_t		mSentCount;
+
+	/// Number of datagrams lost
+	uint16_t		mLostCount;
+
+	/// Number of datagrams reordered
+	uint16_t		mReorderedCount;
+
+	/// Number of datagrams dropped because of the queue full
+	uint16_t		mOverflowCount;
+
+};	// LoopbackTransport
+
+/// Debug: Send the delivery ratio of the contention control against the number of nodes
+/**
+	Simulates `roundCount` rounds in which every node sends a datagram on the same periodic boundary, and counts a datagram delivered only if no other transmission overlaps its airtime.
+	Compares no contention control, the random jitter with the exponential backoff of radio::setContention() and its slotted schedule.
+	Each simulated node runs its own radio::ContentionControl, with a random serial number which derives its slot in the same way as this device.
+	The jitter window is 2 to 32 milliseconds, and the frame has `nodeCountMax` slots of 2 milliseconds.
+*/
+void debug_sendContentionBenchmark(int nodeCountMax = 8, int roundCount = 100);
+
+}	// radio
+}	// microbit_dal_ext_kit
+
+#endif	// EXT_KIT_RADIO_LOOPBACK_H
@@ -17,11 +17,10 @@
 #include "ExtKitComponent.h"
 #include "ExtKitNode.h"
 #include "ExtKitPeriodicObserver.h"
+#include "ExtKitRadio.h"
 #include "ExtKitTime.h"
 #include "ExtKitState.h"
 
-class MicroBitEvent;
-
 namespace microbit_dal_ext_kit {
 
 /// Remote %State components
@@ -48,8 +47,231 @@ const char kMarkerResponse		= '!';
 */
 const char kMarkerNotification	= '@';
 
+/// Wire Format
+enum WireFormat {
+	kWireFormatText,	///< Text commands using the markers above. The sequence number is sent in hex. A command longer than `#kFrameSizeMax` is sent as a binary keyframe instead.
+	kWireFormatBinary,		///< Binary frames. See `#kFrameFlagBinary`.
+	kWireFormatBinaryDelta	///< Binary frames with delta encoded notifications. See `#kFrameFlagDelta`.
+};
+
+/// Binary Frame Flag, which is always set in the flags byte of a binary frame
+/**
+	The binary frame is as follows: <br>
+	CATEGORY_BYTE FLAGS_BYTE SEQUENCE_BYTE PAYLOAD_BYTE* <br>
+	The flag is never set in the marker characters of the text commands, so that the receiving side accepts both formats.
+	Compared with the text command, the sequence number is always 1 byte instead of 1 or 2 hex characters, and the payload is sent as is.
+*/
+const uint8_t kFrameFlagBinary			= 0x80;
+
+/// Binary Frame Kind Mask for the flags byte
+const uint8_t kFrameKindMask			= 0x03;
+
+/// Binary Frame Kind for a request, which corresponds to `#kMarkerRequest`
+const uint8_t kFrameKindRequest			= 0x01;
+
+/// Binary Frame Kind for a response, which corresponds to `#kMarkerResponse`
+const uint8_t kFrameKindResponse		= 0x02;
+
+/// Binary Frame Kind for a notification, which corresponds to `#kMarkerNotification`
+const uint8_t kFrameKindNotification	= 0x03;
+
+/// Binary Frame Flag for a delta encoded payload
+/**
+	The delta encoded payload is as follows: <br>
+	MASK_BYTE+ CHANGED_BYTE* <br>
+	Each bit of the mask bytes tells whether the corresponding byte of the full payload is changed from the previous sequence number.
+	The changed bytes follow the mask bytes in order. The full payload is called a keyframe, which is sent without the flag.
+*/
+const uint8_t kFrameFlagDelta			= 0x04;
+
+/// Binary Frame Flag for a lease, which shares the bit with `#kFrameFlagDelta` and is valid only with `#kFrameKindRequest`
+/**
+	The bit means a delta with `#kFrameKindResponse` or `#kFrameKindNotification`, and a lease with `#kFrameKindRequest`. Check the frame kind before the flag.
+	The payload is a byte of the lease duration in seconds.
+	The transmitter requiring subscriptions sends notifications for the category until the lease expires.
+*/
+const uint8_t kFrameFlagLease			= 0x04;
+
+/// Binary Frame Flag for a batch of frames
+/**
+	The batch frame is as follows: <br>
+	0x00 FLAGS_BYTE ENTRY_COUNT_BYTE (LENGTH_BYTE BINARY_FRAME_BYTE+)+ <br>
+	Each entry is a binary frame for a category, prefixed with its length.
+*/
+const uint8_t kFrameFlagBatch			= 0x08;
+
+/// Binary Frame Flag for a frame to be acknowledged by the receiver
+const uint8_t kFrameFlagAckRequested	= 0x10;
+
+/// Binary Frame Flag for an acknowledgement, which is sent with `#kFrameKindRequest` and the latest sequence number received
+const uint8_t kFrameFlagAck				= 0x20;
+
+/// Binary Frame Flag for a fragment of a large payload
+/**
+	The payload of a fragment is as follows: <br>
+	FRAGMENT_BYTE PAYLOAD_BYTE+ <br>
+	FRAGMENT_BYTE holds the fragment index in the upper 4 bits and the fragment count minus 1 in the lower 4 bits.
+	A request with the flag asks to resend the missing fragments specified by the 16-bit mask following the header in little endian.
+*/
+const uint8_t kFrameFlagFragment		= 0x40;
+
+/// Binary Frame Kind for a relay envelope, which is sent with `#kFrameFlagBatch` instead of a batch
+/**
+	The relay envelope is as follows: <br>
+	0x00 FLAGS_BYTE HOPS_AND_TTL_BYTE ORIGIN_WORD AGE_WORD BINARY_FRAME_BYTE+ <br>
+	HOPS_AND_TTL_BYTE holds the hop count in the upper 4 bits and the TTL in the lower 4 bits.
+	ORIGIN_WORD is the lower 16 bits of the serial number of the sender, and AGE_WORD is the time in milliseconds spent in relays. Both are in little endian.
+*/
+const uint8_t kFrameKindRelay			= 0x01;
+
+/// Binary Frame Header Size
+const int kFrameHeaderSize				= 3;
+
+/// Max Frame Size, which is the max datagram size available for MicroBitRadio
+const int kFrameSizeMax					= 32;
+
+/// Max Payload Size
+const int kPayloadSizeMax				= kFrameSizeMax - kFrameHeaderSize;
+
+/// Relay Envelope Header Size
+const int kRelayHeaderSize				= 7;
+
+/// Max TTL for a relay envelope
+const uint8_t kRelayTtlMax				= 15;
+
+/// Max Fragment Count
+const int kFragmentCountMax				= 16;
+
+/// Payload Size of a fragment except the last one
+const int kFragmentPayloadSize			= kPayloadSizeMax - 1;
+
+/// Max Large Payload Size, which is sent in fragments
+const int kLargePayloadSizeMax			= kFragmentCountMax * kFragmentPayloadSize;
+
+/// Binary Frame Header
+struct FrameHeader
+{
+	/// Category
+	char	category;
+
+	/// Flags
+	uint8_t	flags;
+
+	/// Sequence Number
+	uint8_t	sequence;
+
+};	// FrameHeader
+
+/// Encode a binary frame header into `frame`, where the payload is already placed at `frame + kFrameHeaderSize`. Returns the frame length.
+int /* frameLength */ encodeFrame(uint8_t* /* OUT */ frame, const FrameHeader& header, int payloadLength);
+
+/// Decode a binary frame. Returns the payload length placed at `frame + kFrameHeaderSize`, or -1 if the frame is not a valid binary frame.
+int /* payloadLength */ decodeFrame(const uint8_t* frame, int frameLength, FrameHeader& /* OUT */ header);
+
+/// Link Quality of a category measured by Receiver
+struct LinkQuality
+{
+	/// Packet loss rate in per mille, estimated from the sequence gaps
+	uint16_t			lossRate;
+
+	/// Inter-arrival jitter in milliseconds, which is the smoothed deviation of the intervals between the states received
+	uint16_t			jitter;
+
+	/// RSSI of the last state received, as reported by `PacketBuffer::getRSSI()`. 0 if unknown.
+	int16_t				rssi;
+
+	/// Staleness age in milliseconds since the last state received. `UINT32_MAX` if nothing is received.
+	time::SystemTime	age;
+
+	/// Recovery latency in milliseconds, which is the last duration from the previous state until the state is recovered by a response
+	uint16_t			recoveryLatency;
+
+	/// Number of states received
+	uint16_t			receivedCount;
+
+	/// Number of states lost
+	uint16_t			lostCount;
+
+};	// LinkQuality
+
+/// Relay Envelope Header
+struct RelayHeader
+{
+	/// Number of relays passed
+	uint8_t		hops;
+
+	/// Number of relays to pass yet
+	uint8_t		ttl;
+
+	/// Origin
+	uint16_t	origin;
+
+	/// Time in milliseconds spent in relays
+	uint16_t	age;
+
+};	// RelayHeader
+
+/// Encode a relay envelope for `frame` into `envelope`. Returns the envelope length, or -1 if the frame is too long.
+int /* envelopeLength */ encodeRelayEnvelope(uint8_t* /* OUT */ envelope, const RelayHeader& header, const uint8_t* frame, int frameLength);
+
+/// Decode a relay envelope. Returns the length of the frame placed at `envelope + kRelayHeaderSize`, or -1 if not a relay envelope.
+int /* frameLength */ decodeRelayEnvelope(const uint8_t* envelope, int envelopeLength, RelayHeader& /* OUT */ header);
+
+/// Get the check sum of a frame in a relay envelope, which distinguishes fragments, responses and acks with the same origin, category and sequence number
+uint8_t relayCheckSum(const uint8_t* frame, int frameLength);
+
+/// Set the hop limit for the binary frames sent by Transmitter and Receiver. 0 (default) means that frames are sent without relay envelopes.
+void setRelayHopLimit(uint8_t hopLimit);
+
+/// Get the size of a relay envelope header added to the binary frames sent, which is 0 if the hop limit is 0
+int relayHeaderSize();
+
+/// Send a binary frame in a relay envelope if the hop limit is set and the frame fits in an envelope
+void sendFrame(const uint8_t* frame, int frameLength);
+
+/// Encode the delta between `last` and `current` into `delta`. Returns the delta length, or -1 if the delta is not shorter than `current`.
+int /* deltaLength */ encodeDelta(const uint8_t* last, const uint8_t* current, int length, uint8_t* /* OUT */ delta);
+
+/// Apply `delta` to `state` in place. Returns false without changing `state` if `delta` does not match `length`.
+bool /* applied */ applyDelta(uint8_t* /* IN OUT */ state, int length, const uint8_t* delta, int deltaLength);
+
+/// Category Table, which provides O(1) lookup of a Node keyed by the category byte
+/**
+	The table is direct-indexed and covers only the range between the lowest and the highest category set to the table.
+	It is rebuilt only when the range is extended, so that the lookup cost does not depend on the number of categories.
+*/
+class CategoryTable
+{
+public:
+	/// Constructor
+	CategoryTable();
+
+	/// Destructor
+	~CategoryTable();
+
+	/// Set a node for the category. 0 clears the entry.
+	void set(char category, Node* node);
+
+	/// Get the node for the category. Returns 0 if not set.
+	inline Node* get(char category) {
+		unsigned int i = (uint8_t) category - (unsigned int) mBase;
+		return (i < mSize) ? mTable[i] : 0;
+	}
+
+protected:
+	/// Table
+	Node**		mTable;
+
+	/// The lowest category in the table
+	uint8_t		mBase;
+
+	/// Table Size
+	uint16_t	mSize;
+
+};	// CategoryTable
+
 /// An ext-kit Component which provides the Remote %State Transmitter
-class Transmitter : public Component
+class Transmitter : public Component, PeriodicObserver::HandlerProtocol, radio::DatagramProtocol
 {
 public:
 	/// Get global instance. Valid only after an instance of class `Transmitter` is created.
@@ -68,6 +290,13 @@ public:
 		/// Remote State to be sent
 		virtual /* to be implemented */ ManagedString remoteState() = 0;
 
+		/// Remote State to be sent as a binary payload. Returns the payload length.
+		/**
+			Override this to send a binary frame without heap allocation.
+			The default implementation copies the string returned by remoteState().
+		*/
+		virtual int /* payloadLength */ packRemoteState(uint8_t* /* OUT */ payload, int payloadSizeMax);
+
 	};	// CategoryProtocol
 
 	/// Category Base
@@ -94,6 +323,55 @@ public:
 	/// Request To Send
 	void requestToSend(char category);
 
+	/// Set the wire format used for sending
+	void setWireFormat(WireFormat wireFormat);
+
+	/// Get the wire format used for sending
+	WireFormat wireFormat();
+
+	/// Enable or disable batching. Valid only for the binary wire formats.
+	/**
+		While batching is enabled, requestToSend() only marks the category as pending.
+		The pending categories are packed into as few datagrams as possible every 20 milliseconds.
+		The packing efficiency is reported to Statistics.
+	*/
+	void setBatchEnabled(bool enabled);
+
+	/// Enable or disable the reliable mode for a category. Valid only for the binary wire formats.
+	/**
+		In the reliable mode, notifications are sent with `#kFrameFlagAckRequested` and retained in a small retransmit window until acknowledged.
+		The retransmission timeout adapts to the ack latency. The mode is intended for a category with a single receiver.
+		The receiver never applies a notification older than or equal to the latest sequence number within a small window, and acks it again instead.
+		The first notification of a category is sent as a response, so that a restarted transmitter is not mistaken for retransmissions.
+	*/
+	void setReliable(char category, bool reliable = true);
+
+	/// Set the max payload size for a category. Valid only for the binary wire formats.
+	/**
+		A payload larger than `#kPayloadSizeMax` and up to `payloadSizeMax` is sent in fragments, and is not delta encoded, batched nor retransmitted.
+		The receiver requests the missing fragments only. `payloadSizeMax` is limited to `#kLargePayloadSizeMax`.
+	*/
+	void setPayloadSizeMax(char category, int payloadSizeMax);
+
+	/// Enable or disable the subscription requirement
+	/**
+		While enabled, requestToSend() sends nothing for a category unless a receiver holds a live lease for it. See `Receiver::setLeaseDuration()`.
+		A new subscriber receives the current state as a response. Responses to requests are always sent.
+		The number of notifications suppressed is reported to Statistics.
+	*/
+	void setSubscriptionRequired(bool required);
+
+	/// Set the rate limit for a category
+	/**
+		requestToSend() calls within `minInterval` milliseconds since the last send are coalesced into a single send of the latest state at the end of the interval.
+		If nothing is sent for `keepAliveInterval` milliseconds, the current state is sent again as a response. 0 disables each of them.
+		The number of sends and the number of requests coalesced are reported to Statistics.
+	*/
+	void setRateLimit(char category, uint16_t minInterval, uint16_t keepAliveInterval = 0);
+
+	/// Send benchmark results of the wire formats for the listened categories to the debugger. Nothing is sent to the radio.
+	void debug_sendBenchmark(int repeatCount = 100);
+
 protected:
 	/// Inherited
 	/* Component */ void doHandleComponentAction(Action action);
@@ -106,14 +384,76 @@ private:
 		/// Constructor
 		CategoryRecord(char category, CategoryProtocol& protocol);
 
+		/// Destructor
+		~CategoryRecord();
+
 		/// Request To Send
-		void requestToSend(bool asResponse);
+		void requestToSend(bool asResponse, WireFormat wireFormat);
 
-		/// Send
-		void send(const ManagedString& remoteState, bool asResponse);
+		/// Build the next binary frame to send into `frame`. Returns the frame length.
+		int /* frameLength */ buildNextFrame(uint8_t* /* OUT */ frame, bool asResponse, WireFormat wireFormat);
 
-		/// Handle Radio Command Received
-		void handleRadioCommandReceived(ManagedString& received);
+		/// Build a text command
+		ManagedString buildText(bool asResponse);
+
+		/// Build a binary frame into `frame`. Returns the frame length.
+		int /* frameLength */ buildFrame(uint8_t* /* OUT */ frame, bool asResponse, bool delta = false);
+
+		/// Set Reliable
+		void setReliable(bool reliable);
+
+		/// Check whether the reliable mode is enabled or not
+		inline bool isReliable() {
+			return mWindow != 0;
+		}
+
+		/// Handle Ack Received
+		void handleAckReceived(uint8_t sequence);
+
+		/// Retransmit the frames whose timeout is elapsed
+		void retransmitIfNeeded();
+
+		/// Set the max payload size
+		void setPayloadSizeMax(int payloadSizeMax);
+
+		/// Check whether the payload may be sent in fragments or not
+		inline bool hasLargePayload() {
+			return mLargePayload != 0;
+		}
+
+		/// Send the large payload in fragments specified by `fragmentMask`
+		void sendFragments(bool asResponse, uint16_t fragmentMask);
+
+		/// Handle Resend Request Received
+		void handleResendRequestReceived(uint8_t sequence, uint16_t fragmentMask);
+
+		/// Handle Lease Received. Returns true if the lease is new.
+		bool handleLeaseReceived(uint8_t duration);
+
+		/// Check whether a receiver holds a live lease or not
+		inline bool hasLease() {
+			return leased && !time::isElapsed(leaseExpiry);
+		}
+
+		/// Set the rate limit
+		void setRateLimit(uint16_t minInterval, uint16_t keepAliveInterval);
+
+		/// Check whether the rate limit is set or not
+		inline bool isRateLimited() {
+			return (mMinInterval != 0) || (mKeepAliveInterval != 0);
+		}
+
+		/// Coalesce a request within the min interval. Returns true if the request is deferred.
+		bool coalesce();
+
+		/// Check whether the deferred request is due or not
+		bool isDeferredRequestDue();
+
+		/// Check whether the keep-alive is due or not
+		bool isKeepAliveDue();
+
+		/// Note that the state is sent
+		void noteSent();
 
 		/// Category Protocol
 		CategoryProtocol&	protocol;
@@ -121,14 +461,139 @@ private:
 		/// Category
 		char	category;
 
+		/// Pending for the next batch
+		bool	pending;
+
+		/// Leased by a receiver
+		bool	leased;
+
+		/// Time when the lease expires
+		time::SystemTime	leaseExpiry;
+
+		/// A request is deferred by the rate limit
+		bool	deferred;
+
 	private:
 		/// Sequence Number
 		uint8_t		mSequence;
 
+		/// First notification is sent, which is sent as a response to announce the start of the sequence numbers
+		bool		mStartAnnounced;
+
+		/// Snapshot Length. -1 means no snapshot.
+		int8_t		mSnapshotLength;
+
+		/// Snapshot of the payload sent with the sequence number, which is allocated for `#kWireFormatBinaryDelta` only
+		uint8_t*	mSnapshot;
+
+		/// Retransmit Entry
+		struct RetransmitEntry
+		{
+			/// Frame
+			uint8_t				frame[kFrameSizeMax];
+
+			/// Frame Length
+			uint8_t				frameLength;
+
+			/// Retry Count
+			uint8_t				retryCount;
+
+			/// Time when the frame is sent first
+			time::SystemTime	sentTime;
+
+			/// Time when the frame is retransmitted next
+			time::SystemTime	deadline;
+
+		};	// RetransmitEntry
+
+		/// Retain a frame in the retransmit window
+		void retain(const uint8_t* frame, int frameLength);
+
+		/// Remove the oldest entries from the retransmit window
+		void removeEntries(int count);
+
+		/// Update the retransmission timeout with a round trip time sample
+		void updateRetransmitTimeout(time::SystemTime sample);
+
+		/// Retransmit Window, which is allocated for the reliable mode only. The oldest entry comes first.
+		RetransmitEntry*	mWindow;
+
+		/// Number of entries in the retransmit window
+		uint8_t		mWindowCount;
+
+		/// Smoothed Round Trip Time in milliseconds. 0 means no sample.
+		uint16_t	mSmoothedRtt;
+
+		/// Round Trip Time Variance in milliseconds
+		uint16_t	mRttVariance;
+
+		/// Retransmission Timeout in milliseconds
+		uint16_t	mRetransmitTimeout;
+
+		/// Number of retransmissions
+		uint16_t	mRetransmitCount;
+
+		/// Number of frames given up
+		uint16_t	mUndeliveredCount;
+
+		/// Statistics Key String for Retransmit Count
+		ManagedString	mStatisticsRetransmitCount;
+
+		/// Statistics Key String for Undelivered Count
+		ManagedString	mStatisticsUndeliveredCount;
+
+		/// Statistics Key String for Retransmit Timeout
+		ManagedString	mStatisticsRetransmitTimeout;
+
+		/// Large Payload sent with the sequence number, which is allocated by setPayloadSizeMax() only
+		uint8_t*	mLargePayload;
+
+		/// Large Payload Size
+		uint16_t	mLargePayloadSize;
+
+		/// Large Payload Length. 0 means nothing is sent.
+		uint16_t	mLargePayloadLength;
+
+		/// Min Interval in milliseconds between sends
+		uint16_t	mMinInterval;
+
+		/// Keep-Alive Interval in milliseconds
+		uint16_t	mKeepAliveInterval;
+
+		/// Time when the state is sent last
+		time::SystemTime	mLastSentTime;
+
+		/// Number of sends
+		uint16_t	mSentCount;
+
+		/// Number of requests coalesced
+		uint16_t	mCoalescedCount;
+
+		/// Statistics Key String for Sent Count
+		ManagedString	mStatisticsSentCount;
+
+		/// Statistics Key String for Coalesced Count
+		ManagedString	mStatisticsCoalescedCount;
+
 	};	// CategoryRecord
 
-	/// Handle Radio Datagram Received
-	void handleRadioDatagramReceived(MicroBitEvent event);
+	/// Find Category Record
+	CategoryRecord* findCategoryRecord(char category);
+
+	/// Inherited
+	/* radio::DatagramProtocol */ void handleRadioDatagram(const uint8_t* datagram, int length);
+
+	/// Inherited
+	/* PeriodicObserver::HandlerProtocol */ void handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit);
+
+	/// Send the pending categories in batches
+	void sendBatches();
+
+	/// Send a batch with `entryCount` entries. A batch with a single entry is sent as a plain frame.
+	void sendBatch(uint8_t* batch, int batchLength, int entryCount);
+
+	/// Send a datagram containing `frameCount` frames while batching
+	void sendDatagram(const uint8_t* datagram, int datagramLength, int frameCount);
 
 	/// Global instance
 	static Transmitter*	sGlobal;
@@ -136,10 +601,43 @@ private:
 	/// Root Node for CategoryRecord
 	RootForDynamicNodes	mRoot;
 
+	/// Category Table for CategoryRecord
+	CategoryTable	mTable;
+
+	/// Wire Format
+	WireFormat	mWireFormat;
+
+	/// Batching is enabled
+	bool		mBatchEnabled;
+
+	/// Some categories are pending for the next batch
+	bool		mBatchPending;
+
+	/// Total number of frames sent while batching is enabled
+	uint32_t	mBatchFrameCount;
+
+	/// Total number of datagrams sent while batching is enabled
+	uint32_t	mBatchDatagramCount;
+
+	/// Total number of bytes sent while batching is enabled
+	uint32_t	mBatchByteCount;
+
+	/// Number of categories in the reliable mode
+	uint8_t		mReliableCount;
+
+	/// Number of categories with the rate limit
+	uint8_t		mRateLimitedCount;
+
+	/// Subscriptions are required
+	bool		mSubscriptionRequired;
+
+	/// Number of notifications suppressed because of no subscriber
+	uint16_t	mUnsubscribedCount;
+
 };	// Transmitter
 
 /// An ext-kit Component which provides the Remote %State Receiver
-class Receiver : public Component, PeriodicObserver::HandlerProtocol
+class Receiver : public Component, PeriodicObserver::HandlerProtocol, radio::DatagramProtocol
 {
 public:
 	/// Get global instance. Valid only after an instance of class `Receiver` is created.
@@ -158,6 +656,26 @@ public:
 		/// Handle Remote State received
 		virtual /* to be implemented */ void handleRemoteState(ManagedString& received) = 0;
 
+		/// Handle Remote State received as a binary payload
+		/**
+			Override this to receive a binary frame without heap allocation.
+			The default implementation calls handleRemoteState() with the equivalent text command.
+		*/
+		virtual void handlePackedRemoteState(const FrameHeader& header, const uint8_t* payload, int payloadLength);
+
+		/// Handle Remote State gone stale, which is called once when nothing is received for the stale timeout. See `Receiver::setStaleTimeout()`.
+		/**
+			Override this to take a fail-safe action, such as stopping motors. The default implementation does nothing.
+			The next state received is always passed to the handlers even if the sequence number is not changed.
+		*/
+		virtual void handleRemoteStateStale();
+
+		/// Handle the numeric fields predicted between updates. See `Receiver::setPrediction()`.
+		/**
+			Called every 100 milliseconds while the prediction is enabled. The default implementation does nothing.
+		*/
+		virtual void handlePredictedFields(const int16_t* fields, int fieldCount);
+
 	};	// CategoryProtocol
 
 	/// Category Base
@@ -181,6 +699,47 @@ public:
 	/// Ignore
 	void ignore(char category);
 
+	/// Set the wire format used for sending requests. Both formats are always accepted.
+	void setWireFormat(WireFormat wireFormat);
+
+	/// Get the wire format used for sending requests
+	WireFormat wireFormat();
+
+	/// Set the lease duration in seconds for the subscriptions of the listened categories. 0 (default) means no subscription.
+	/**
+		Leases are announced on the first periodic event after a category is listened or the receiver is started, and renewed at half the duration, so that transmitters requiring subscriptions keep sending notifications.
+		Ignoring a category stops the renewal, and the lease expires at the transmitter.
+	*/
+	void setLeaseDuration(uint8_t seconds);
+
+	/// Prediction Mode
+	enum PredictionMode {
+		/// No prediction
+		kPredictionNone,
+		/// Extrapolate the fields linearly with the rate between the last two updates, up to the horizon
+		kPredictionLinear,
+		/// Decay the fields linearly to zero over the horizon
+		kPredictionDecay
+	};
+
+	/// Set the stale timeout in milliseconds for a category. 0 (default) disables the staleness detection.
+	void setStaleTimeout(char category, uint16_t timeout);
+
+	/// Check whether the state of a category is stale or not
+	bool isStale(char category);
+
+	/// Set the prediction of `fieldCount` numeric fields for a category. The fields are given by updateFields() when a state is received.
+	void setPrediction(char category, int fieldCount, PredictionMode mode, uint16_t horizon);
+
+	/// Update the numeric fields of a category, which should be called by the category protocol when a state is received
+	void updateFields(char category, const int16_t* fields);
+
+	/// Get the link quality of a category. Returns false if the category is not listened.
+	bool linkQuality(char category, LinkQuality& /* OUT */ quality);
+
+	/// Send the link quality of the listened categories to the debugger
+	static void debug_sendLinkQuality();
+
 protected:
 	/// Inherited
 	/* Component */ void doHandleComponentAction(Action action);
@@ -193,12 +752,47 @@ private:
 		/// Constructor
 		CategoryRecord(char category, CategoryProtocol& protocol);
 
+		/// Destructor
+		~CategoryRecord();
+
 		/// Request To Send
 		void requestToSend();
 
 		/// Handle Radio Command Received
 		void handleRadioCommandReceived(ManagedString& received);
 
+		/// Handle Radio Frame Received
+		void handleRadioFrameReceived(const uint8_t* frame, int frameLength);
+
+		/// Check whether a frame with the latest sequence number is already applied
+		bool isApplied(const FrameHeader& header, const uint8_t* payload, int payloadLength);
+
+		/// Send an acknowledgement with the latest sequence number
+		void sendAck();
+
+		/// Send a lease for `duration` seconds
+		void sendLease(uint8_t duration);
+
+		/// Get the link quality
+		void getLinkQuality(LinkQuality& /* OUT */ quality);
+
+		/// Set the stale timeout
+		void setStaleTimeout(uint16_t timeout);
+
+		/// Check whether the state is stale or not
+		inline bool isStale() {
+			return mStale;
+		}
+
+		/// Set the prediction
+		void setPrediction(int fieldCount, PredictionMode mode, uint16_t horizon);
+
+		/// Update the numeric fields
+		void updateFields(const int16_t* fields);
+
+		/// Handle a payload reassembled from fragments
+		void handleReassembledPayload(FrameHeader& header, const uint8_t* payload, int payloadLength);
+
 		/// Handle Periodic Event
 		void handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit);
 
@@ -210,6 +804,18 @@ private:
 		char	category;
 
 	private:
+		/// Accept a sequence number. Returns false if the sequence number is not changed.
+		bool acceptSequence(uint8_t sequence, bool asResponse);
+
+		/// Update the link quality for a state received
+		void updateLinkQuality(uint8_t previous, uint8_t sequence, bool changed, bool asResponse);
+
+		/// Check the staleness
+		void checkStaleness();
+
+		/// Predict the numeric fields
+		void predictFields();
+
 		/// Sequence Number
 		State<uint8_t>	mSequence;
 
@@ -225,10 +831,149 @@ private:
 		/// Statistics Key String for Recovery Count
 		ManagedString	mStatisticsRecoveryCount;
 
+		/// Statistics Key String for Duplicate Count
+		ManagedString	mStatisticsDuplicateCount;
+
+		/// Snapshot Length. -1 means no valid snapshot.
+		int8_t		mSnapshotLength;
+
+		/// Keyframe is requested because of a sequence gap
+		bool		mKeyframeRequested;
+
+		/// Snapshot of the full payload for the sequence number, which is allocated when a binary frame is received
+		uint8_t*	mSnapshot;
+
+		/// Time when the last state is received
+		time::SystemTime	mLastReceivedTime;
+
+		/// Smoothed interval in milliseconds between the states received
+		uint16_t	mMeanInterval;
+
+		/// Inter-arrival jitter in 1/16 milliseconds, which keeps the fraction of the smoothing
+		uint32_t	mJitter;
+
+		/// Packet loss rate in 1/16 per mille, which keeps the fraction of the smoothing
+		uint16_t	mLossRate;
+
+		/// Recovery latency in milliseconds
+		uint16_t	mRecoveryLatency;
+
+		/// Number of states received
+		uint16_t	mReceivedCount;
+
+		/// Number of states lost
+		uint16_t	mLostCount;
+
+		/// RSSI of the last state received
+		int16_t		mRssi;
+
+		/// Stale Timeout in milliseconds
+		uint16_t	mStaleTimeout;
+
+		/// The state is stale
+		bool		mStale;
+
+		/// Prediction Mode
+		uint8_t		mPredictionMode;
+
+		/// Number of numeric fields
+		uint8_t		mFieldCount;
+
+		/// Prediction Horizon in milliseconds
+		uint16_t	mPredictionHorizon;
+
+		/// Number of updates of the numeric fields
+		uint8_t		mFieldsUpdateCount;
+
+		/// Time when the numeric fields are updated last
+		time::SystemTime	mFieldsTime;
+
+		/// Interval in milliseconds between the last two updates of the numeric fields
+		time::SystemTime	mFieldsInterval;
+
+		/// Numeric fields, which are the last, the previous and the predicted values in order, allocated by setPrediction() only
+		int16_t*	mFields;
+
 	};	// CategoryRecord
 
-	/// Handle Radio Datagram Received
-	void handleRadioDatagramReceived(MicroBitEvent event);
+	/// Find Category Record
+	CategoryRecord* findCategoryRecord(char category);
+
+	/// Inherited
+	/* radio::DatagramProtocol */ void handleRadioDatagram(const uint8_t* datagram, int length);
+
+	/// Handle a datagram or an entry of a batch
+	void handleDatagram(const uint8_t* frame, int frameLength);
+
+	/// Relayed Entry, which is keyed by origin, category, sequence number and check sum
+	struct RelayedEntry
+	{
+		/// Origin
+		uint16_t	origin;
+
+		/// Category, which is 0 for a batch
+		char		category;
+
+		/// Sequence Number
+		uint8_t		sequence;
+
+		/// Check Sum of the frame
+		uint8_t		checkSum;
+
+		/// Entry is used
+		bool		used;
+
+	};	// RelayedEntry
+
+	/// Relayed Cache Size
+	static const int kRelayedCacheSize = 8;
+
+	/// Check whether a frame in a relay envelope is already received directly or from a relay, and remember the frame if not. A frame to be acknowledged is never regarded as a duplicate.
+	bool isRelayedDuplicate(const RelayHeader& header, const uint8_t* frame, int frameLength);
+
+	/// Reassembly Slot Count
+	static const int kReassemblySlotCount = 2;
+
+	/// Reassembly Slot
+	struct ReassemblySlot
+	{
+		/// Category Record. 0 means the slot is free.
+		CategoryRecord*		record;
+
+		/// Header of the first fragment received
+		FrameHeader			header;
+
+		/// Fragment Count
+		uint8_t				fragmentCount;
+
+		/// Number of resend requests
+		uint8_t				resendCount;
+
+		/// Mask of the fragments received
+		uint16_t			receivedMask;
+
+		/// Length of the payload reassembled
+		uint16_t			length;
+
+		/// Buffer taken from the reassembly pool
+		uint8_t*			buffer;
+
+		/// Time when the reassembly is timed out
+		time::SystemTime	deadline;
+
+	};	// ReassemblySlot
+
+	/// Handle Fragment Received
+	void handleFragmentReceived(CategoryRecord& record, const FrameHeader& header, const uint8_t* payload, int payloadLength);
+
+	/// Request to resend the missing fragments
+	void requestToResend(ReassemblySlot& slot);
+
+	/// Check the reassembly timeouts
+	void checkReassemblyTimeouts();
+
+	/// Free a reassembly slot
+	void freeReassemblySlot(ReassemblySlot& slot);
 
 	/// Inherited
 	/* PeriodicObserver::HandlerProtocol */ void handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit);
@@ -240,8 +985,153 @@ private:
 	/// Root Node for CategoryRecord
 	RootForDynamicNodes mRoot;
 
+	/// Category Table for CategoryRecord
+	CategoryTable	mTable;
+
+	/// Reassembly Slots
+	ReassemblySlot	mReassemblySlots[kReassemblySlotCount];
+
+	/// Bytes used in the reassembly pool
+	uint16_t	mReassemblyPoolUsed;
+
+	/// Wire Format
+	WireFormat	mWireFormat;
+
+	/// Lease Duration in seconds
+	uint8_t		mLeaseDuration;
+
+	/// Lease Next Count in `PeriodicObserver::kUnit100ms`
+	uint32_t	mLeaseNextCount;
+
+	/// Relayed Cache of the frames received in relay envelopes
+	RelayedEntry	mRelayedCache[kRelayedCacheSize];
+
+	/// Index of the Relayed Entry to be replaced next
+	uint8_t			mRelayedCacheNext;
+
+	/// Number of the relayed copies dropped as duplicates
+	uint16_t		mRelayedDuplicateCount;
+
 };	// Receiver
 
+/// An ext-kit Component which provides the Remote %State Relay, which rebroadcasts relay envelopes
+/**
+	A relay envelope not seen yet is rebroadcast after a random delay, with the TTL decremented.
+	The rebroadcast is cancelled if the same envelope is heard from another relay in the meantime, and the delay window is widened then.
+	The relay load is reported to Statistics.
+*/
+class Relay : public Component, PeriodicObserver::HandlerProtocol, radio::DatagramProtocol
+{
+public:
+	/// Get global instance. Valid only after an instance of class `Relay` is created.
+	static Relay& global();
+
+	/// Constructor
+	Relay();
+
+	/// Destructor
+	~Relay();
+
+protected:
+	/// Inherited
+	/* Component */ void doHandleComponentAction(Action action);
+
+private:
+	/// Duplicate Cache Entry, which is keyed by origin, category and sequence number
+	struct DuplicateEntry
+	{
+		/// Origin
+		uint16_t	origin;
+
+		/// Category
+		char		category;
+
+		/// Sequence Number
+		uint8_t		sequence;
+
+		/// Check Sum of the frame, which distinguishes fragments, responses and acks with the same sequence number
+		uint8_t		checkSum;
+
+		/// Number of times heard
+		uint8_t		heardCount;
+
+	};	// DuplicateEntry
+
+	/// Pending Entry for a rebroadcast
+	struct PendingEntry
+	{
+		/// Envelope
+		uint8_t				envelope[kFrameSizeMax];
+
+		/// Envelope Length. 0 means the entry is free.
+		uint8_t				envelopeLength;
+
+		/// Index of the Duplicate Cache Entry
+		uint8_t				cacheIndex;
+
+		/// Time when the envelope is received
+		time::SystemTime	receivedTime;
+
+		/// Time when the envelope is rebroadcast
+		time::SystemTime	dueTime;
+
+	};	// PendingEntry
+
+	/// Duplicate Cache Size
+	static const int kDuplicateCacheSize = 16;
+
+	/// Pending Entry Count
+	static const int kPendingCount = 4;
+
+	/// Inherited
+	/* radio::DatagramProtocol */ void handleRadioDatagram(const uint8_t* datagram, int length);
+
+	/// Inherited
+	/* PeriodicObserver::HandlerProtocol */ void handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit);
+
+	/// Find or add the Duplicate Cache Entry. Returns the index and sets `found` true if the entry is found.
+	int /* cacheIndex */ lookUpDuplicateCache(const RelayHeader& header, const uint8_t* frame, int frameLength, bool& /* OUT */ found);
+
+	/// Widen the delay window for backoff
+	void widenDelayWindow();
+
+	/// Global instance
+	static Relay*	sGlobal;
+
+	/// Origin of this device
+	uint16_t		mOrigin;
+
+	/// Duplicate Cache
+	DuplicateEntry	mCache[kDuplicateCacheSize];
+
+	/// Index of the Duplicate Cache Entry to be replaced next
+	uint8_t			mCacheNext;
+
+	/// Pending Entries
+	PendingEntry	mPending[kPendingCount];
+
+	/// Delay Window in milliseconds
+	uint16_t		mDelayWindow;
+
+	/// Number of envelopes rebroadcast
+	uint16_t		mForwardedCount;
+
+	/// Number of envelopes suppressed as duplicates
+	uint16_t		mSuppressedCount;
+
+	/// Number of envelopes dropped because of no pending entry available or the TTL expired
+	uint16_t		mDroppedCount;
+
+};	// Relay
+
+/// Debug: Send the results of the protocol benchmark over `radio::LoopbackTransport`
+/**
+	Measures the update latency, the datagrams per state change and the recovery time after loss, which depends on the sync backoff of the Receiver.
+	`category` should not be used by others.
+	Valid only while Transmitter, Receiver, radio::LoopbackTransport and PeriodicObserver are started.
+*/
+void debug_sendLoopbackBenchmark(char category = '~', int changeCount = 20);
+
 }	// remoteState
 }	// microbit_dal_ext_kit
 
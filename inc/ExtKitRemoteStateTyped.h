@@ -0,0 +1,210 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Typed Remote State categories
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#ifndef EXT_KIT_REMOTE_STATE_TYPED_H
+#define EXT_KIT_REMOTE_STATE_TYPED_H
+
+#include "ExtKitRemoteState.h"
+
+namespace microbit_dal_ext_kit {
+namespace remoteState {
+
+/// Typed Field, which describes a fixed-width integer member of a typed state
+struct TypedField
+{
+	/// Offset of the member
+	uint8_t		offset;
+
+	/// Size of the member in bytes
+	uint8_t		size;
+
+};	// TypedField
+
+/// Define a Typed Field for a member of a typed state
+#define EXT_KIT_REMOTE_STATE_TYPED_FIELD(type, member)	{ offsetof(type, member), sizeof(((type*) 0)->member) }
+
+/// Max number of fields in a typed state, which is limited by the change mask
+const int kTypedFieldCountMax = 32;
+
+/// Marker character which precedes the hex encoded payload in the text command
+const char kMarkerTypedPayload = '=';
+
+/// Max packed size of a typed state sent as a text command, which is the category, the marker, up to 2 hex digits of the sequence number, `#kMarkerTypedPayload` and 2 hex digits per byte in a datagram
+const int kTypedTextPayloadSizeMax = (kFrameSizeMax - 5) / 2;
+
+/// Typed state utility, which is shared by the typed category templates
+namespace typed {
+
+/// Get the packed size of the fields
+int /* size */ packedSize(const TypedField* fields, int fieldCount);
+
+/// Pack the fields of `state` in order into `payload`. Returns the payload length, or 0 if `payloadSizeMax` is too small.
+int /* payloadLength */ pack(const void* state, const TypedField* fields, int fieldCount, uint8_t* /* OUT */ payload, int payloadSizeMax);
+
+/// Unpack `payload` into the fields of `state`. Returns the mask of the fields changed, or 0 if the payload length is not matched.
+uint32_t /* changedMask */ unpack(void* /* IN OUT */ state, const TypedField* fields, int fieldCount, const uint8_t* payload, int payloadLength);
+
+/// Compare the fields of two states. Returns the mask of the fields changed.
+uint32_t /* changedMask */ compare(const void* state, const void* newState, const TypedField* fields, int fieldCount);
+
+/// Encode the payload in hex for the text command
+ManagedString encodeText(const uint8_t* payload, int payloadLength);
+
+/// Decode the hex encoded payload in the text command. Returns the payload length.
+int /* payloadLength */ decodeText(const ManagedString& received, uint8_t* /* OUT */ payload, int payloadSizeMax);
+
+}	// typed
+
+/// Typed Transmitter Category Template
+/**
+	`T` is a struct of fixed-width integer members, which declares `static const TypedField kFields[]` and `static const int kFieldCount`.
+	The fields are packed in the declared order in the native byte order, without any string formatting for the binary wire formats.
+	Requests are handled by the Transmitter with the usual markers and sequence numbers.
+	In the text wire format, a state packed into more than `#kTypedTextPayloadSizeMax` bytes does not fit in a datagram, and is sent as a binary keyframe instead.
+	A state packed into more than `#kPayloadSizeMax` bytes requires a binary wire format and `Transmitter::setPayloadSizeMax()`.
+*/
+template <class T>
+class TypedTransmitterCategory : public Transmitter::CategoryBase
+{
+public:
+	/// Constructor
+	TypedTransmitterCategory(char category);
+
+	/// Set the state and request to send if any field is changed. Returns the mask of the fields changed.
+	uint32_t /* changedMask */ set(const T& state);
+
+	/// Get the state
+	const T& state() const;
+
+	/// Inherited
+	/* Transmitter::CategoryProtocol */ ManagedString remoteState();
+
+	/// Inherited
+	/* Transmitter::CategoryProtocol */ int /* payloadLength */ packRemoteState(uint8_t* /* OUT */ payload, int payloadSizeMax);
+
+protected:
+	/// State
+	T	mState;
+
+};	// TypedTransmitterCategory<T>
+
+/// Typed Receiver Category Template
+/**
+	`T` is the same struct as the one for TypedTransmitterCategory.
+	The state received is unpacked into `T` without heap allocation for the binary wire formats.
+*/
+template <class T>
+class TypedReceiverCategory : public Receiver::CategoryBase
+{
+public:
+	/// Constructor
+	TypedReceiverCategory(char category);
+
+	/// Get the state
+	const T& state() const;
+
+	/// Handle the typed state received with the mask of the fields changed
+	virtual /* to be implemented */ void handleTypedRemoteState(const T& state, uint32_t changedMask) = 0;
+
+	/// Inherited
+	/* Receiver::CategoryProtocol */ void handleRemoteState(ManagedString& received);
+
+	/// Inherited
+	/* Receiver::CategoryProtocol */ void handlePackedRemoteState(const FrameHeader& header, const uint8_t* payload, int payloadLength);
+
+protected:
+	/// State
+	T	mState;
+
+};	// TypedReceiverCategory<T>
+
+/**	@class	TypedTransmitterCategory
+*/
+
+template <class T>
+TypedTransmitterCategory<T>::TypedTransmitterCategory(char category)
+	: Transmitter::CategoryBase(category)
+	, mState()
+{
+	static_assert(T::kFieldCount <= kTypedFieldCountMax, "too many fields");
+}
+
+template <class T>
+uint32_t /* changedMask */ TypedTransmitterCategory<T>::set(const T& state)
+{
+	uint32_t changedMask = typed::compare(&mState, &state, T::kFields, T::kFieldCount);
+	if(changedMask) {
+		mState = state;
+		mTransmitter.requestToSend(mCategory);
+	}
+	return changedMask;
+}
+
+template <class T>
+const T& TypedTransmitterCategory<T>::state() const
+{
+	return mState;
+}
+
+template <class T>
+/* Transmitter::CategoryProtocol */ ManagedString TypedTransmitterCategory<T>::remoteState()
+{
+	uint8_t payload[kPayloadSizeMax];
+	int payloadLength = typed::pack(&mState, T::kFields, T::kFieldCount, payload, sizeof(payload));
+	return typed::encodeText(payload, payloadLength);
+}
+
+template <class T>
+/* Transmitter::CategoryProtocol */ int /* payloadLength */ TypedTransmitterCategory<T>::packRemoteState(uint8_t* /* OUT */ payload, int payloadSizeMax)
+{
+	return typed::pack(&mState, T::kFields, T::kFieldCount, payload, payloadSizeMax);
+}
+
+/**	@class	TypedReceiverCategory
+*/
+
+template <class T>
+TypedReceiverCategory<T>::TypedReceiverCategory(char category)
+	: Receiver::CategoryBase(category)
+	, mState()
+{
+	static_assert(T::kFieldCount <= kTypedFieldCountMax, "too many fields");
+}
+
+template <class T>
+const T& TypedReceiverCategory<T>::state() const
+{
+	return mState;
+}
+
+template <class T>
+/* Receiver::CategoryProtocol */ void TypedReceiverCategory<T>::handleRemoteState(ManagedString& received)
+{
+	uint8_t payload[kPayloadSizeMax];
+	int payloadLength = typed::decodeText(received, payload, sizeof(payload));
+	handlePackedRemoteState(FrameHeader(), payload, payloadLength);
+}
+
+template <class T>
+/* Receiver::CategoryProtocol */ void TypedReceiverCategory<T>::handlePackedRemoteState(const FrameHeader& /* header */, const uint8_t* payload, int payloadLength)
+{
+	if(typed::packedSize(T::kFields, T::kFieldCount) != payloadLength) {
+		return;	// invalid payload
+	}
+
+	uint32_t changedMask = typed::unpack(&mState, T::kFields, T::kFieldCount, payload, payloadLength);
+	handleTypedRemoteState(mState, changedMask);
+}
+
+}	// remoteState
+}	// microbit_dal_ext_kit
+
+#endif	// EXT_KIT_REMOTE_STATE_TYPED_H
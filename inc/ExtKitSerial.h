@@ -39,6 +39,23 @@ void send(const char* s);
 /// Send a string to the serial port
 void send(const ManagedString& s);
 
+/// Send strings to the serial port as a whole. Null strings are skipped.
+/**
+	If the TX queue is enabled with `YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_TXQUEUE`, the strings are copied into the queue together and sent by the drain fiber, so that they are never interleaved with the output of the other fibers.
+	If the queue does not have room for all of them, they are dropped as a whole and counted as an overflow. Returns false then.
+	The caller never waits for the serial port while the queue is enabled.
+*/
+bool sendAll(const char* const* strings, int count);
+
+/// Send the strings in the TX queue in the calling fiber and wait until the queue is empty
+void flush();
+
+/// Send binary data to the serial port after flushing the TX queue. The calling fiber waits for the serial port.
+void sendBinary(const uint8_t* buffer, size_t length);
+
+/// Send a string to the serial port after flushing the TX queue, bypassing the queue. The calling fiber waits for the serial port. Use this for a message which must not be dropped, e.g., an error.
+void sendUnqueued(const char* s);
+
 /// Send a line to the serial port
 void sendLine(char c, const char* suffix = "\r\n");
 
@@ -12,6 +12,8 @@
 #ifndef EXT_KIT_STRING_H
 #define EXT_KIT_STRING_H
 
+#include <stdarg.h>	// va_list
+
 #include "ExtKit_Common.h"
 
 class ManagedString;
@@ -64,6 +66,16 @@ ManagedString dec(int number);
 /// Create a hexadecimal string from a number and a prefix character.
 ManagedString hex(uint32_t number, char prefix = 0);
 
+/// Format a string into `buffer` of `size` bytes without heap allocation. Returns the length of the string formatted.
+/**
+	Supports `%d`, `%u`, `%x`, `%X`, `%s`, `%c` and `%%`, with the optional flags `-` (left-justify) and `0` (zero-pad) and an optional width, e.g., `%08x` and `%-12s`.
+	The string is truncated to `size - 1` characters and always terminated with NUL if `size` is not 0.
+*/
+int format(char* /* OUT */ buffer, size_t size, const char* fmt, ...) __attribute__ ((format (printf, 3, 4)));
+
+/// Format a string into `buffer` of `size` bytes without heap allocation. Returns the length of the string formatted.
+int formatV(char* /* OUT */ buffer, size_t size, const char* fmt, va_list args);
+
 }	// string
 }	// microbit_dal_ext_kit
 
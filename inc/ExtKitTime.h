@@ -25,12 +25,18 @@ typedef uint32_t	SystemTime;
 /// Long System Time in milliseconds
 typedef uint64_t	LongSystemTime;
 
+/// Micro Time in microseconds, for measuring a short duration. It wraps around in about 71 minutes.
+typedef uint32_t	MicroTime;
+
 /// Get the current System Time in milliseconds
 SystemTime /* milliseconds */ systemTime();
 
 /// Get the current Long System Time in milliseconds
 LongSystemTime /* milliseconds */ longSystemTime();
 
+/// Get the current Micro Time in microseconds
+MicroTime /* microseconds */ microTime();
+
 /// Duration in milliseconds For a System Time
 SystemTime durationFor(SystemTime target);
 
@@ -43,9 +49,30 @@ bool isElapsed(SystemTime target);
 /// Check whether a Long System Time is elapsed or not
 bool isElapsed(LongSystemTime target);
 
+/// Network Time in milliseconds, which is the System Time of the master estimated by TimeSync
+typedef uint32_t	NetworkTime;
+
+/// Get the current Network Time in milliseconds. Same as `systemTime()` until TimeSync sets the estimate.
+NetworkTime /* milliseconds */ networkTime();
+
+/// Get the System Time for a Network Time
+SystemTime systemTimeForNetworkTime(NetworkTime target);
+
+/// Duration in milliseconds For a Network Time
+SystemTime durationForNetworkTime(NetworkTime target);
+
+/// Check whether a Network Time is elapsed or not
+bool isNetworkTimeElapsed(NetworkTime target);
+
+/// Set the estimate of Network Time, which is `systemTime() + offset` at `reference` and drifts `drift` in ppm since then
+void setNetworkTimeEstimate(SystemTime reference, int32_t offset, int32_t drift);
+
 /// Sleep milliseconds
 void sleep(uint32_t milliseconds);
 
+/// Sleep until a Network Time
+void sleepUntilNetworkTime(NetworkTime target);
+
 /// Sleep forever
 void sleep();
 
@@ -0,0 +1,146 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Time Sync component
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#ifndef EXT_KIT_TIME_SYNC_H
+#define EXT_KIT_TIME_SYNC_H
+
+#include "ExtKitComponent.h"
+#include "ExtKitPeriodicObserver.h"
+#include "ExtKitRadio.h"
+#include "ExtKitTime.h"
+
+namespace microbit_dal_ext_kit {
+
+/// An ext-kit Component which provides the network time synchronization over the radio
+/**
+	The master answers sync requests with its Network Time.
+	A slave sends sync requests periodically and estimates the offset and the drift of the master's time, so that `time::networkTime()` follows the master.
+	The offset is taken from the exchange with the shortest round trip among the recent samples, in the same way as NTP.
+	Only one master is expected in a radio group.
+
+	The sync datagram is as follows: <br>
+	0x00 FLAGS_BYTE SEQUENCE_BYTE T1_LONG [T2_LONG T3_LONG] <br>
+	FLAGS_BYTE is `kFlagsRequest` or `kFlagsResponse`. T1 is the System Time of the slave when the request is sent,
+	and T2 and T3 are the Network Times of the master when the request is received and when the response is sent. All of them are in little endian.
+*/
+class TimeSync : public Component, PeriodicObserver::HandlerProtocol, radio::DatagramProtocol
+{
+public:
+	/// Role
+	enum Role {
+		/// Master, which provides the Network Time
+		kRoleMaster,
+		/// Slave, which follows the master
+		kRoleSlave
+	};
+
+	/// Flags Byte for a sync request, which shares category 0 with the remoteState batches and relay envelopes
+	static const uint8_t kFlagsRequest	= 0x8a;
+
+	/// Flags Byte for a sync response
+	static const uint8_t kFlagsResponse	= 0x8b;
+
+	/// Get global instance. Valid only after an instance of class `TimeSync` is created.
+	static TimeSync& global();
+
+	/// Constructor
+	TimeSync(Role role);
+
+	/// Destructor
+	~TimeSync();
+
+	/// Get the role
+	Role role();
+
+	/// Check whether the Network Time is synchronized with the master or not. Always true for the master.
+	bool isSynchronized();
+
+	/// Get the estimated error bound of the Network Time in milliseconds
+	uint16_t accuracy();
+
+protected:
+	/// Inherited
+	/* Component */ void doHandleComponentAction(Action action);
+
+private:
+	/// Sample of an exchange
+	struct Sample
+	{
+		/// System Time when the response is received
+		time::SystemTime	localTime;
+
+		/// Offset of the master's time in milliseconds
+		int32_t				offset;
+
+		/// Round Trip Time in milliseconds
+		uint16_t			roundTrip;
+
+	};	// Sample
+
+	/// Sample Count for the round trip filtering
+	static const int kSampleCount = 8;
+
+	/// Inherited
+	/* radio::DatagramProtocol */ void handleRadioDatagram(const uint8_t* datagram, int length);
+
+	/// Inherited
+	/* PeriodicObserver::HandlerProtocol */ void handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit);
+
+	/// Send a sync request
+	void sendRequest();
+
+	/// Handle a sync request
+	void handleRequest(const uint8_t* datagram, int length, time::NetworkTime receivedTime);
+
+	/// Handle a sync response
+	void handleResponse(const uint8_t* datagram, int length, time::SystemTime receivedTime);
+
+	/// Add a sample and update the estimate
+	void addSample(const Sample& sample);
+
+	/// Global instance
+	static TimeSync*	sGlobal;
+
+	/// Role
+	Role				mRole;
+
+	/// Sequence Number of the last request
+	uint8_t				mSequence;
+
+	/// Periodic count for the next request
+	uint32_t			mNextCount;
+
+	/// Samples
+	Sample				mSamples[kSampleCount];
+
+	/// Number of valid samples
+	uint8_t				mSampleCount;
+
+	/// Index of the sample to be replaced next
+	uint8_t				mSampleNext;
+
+	/// Estimated error bound in milliseconds
+	uint16_t			mAccuracy;
+
+	/// Drift in ppm
+	int32_t				mDrift;
+
+	/// Drift Reference Time, which is 0 if not set
+	time::SystemTime	mDriftReferenceTime;
+
+	/// Offset at the Drift Reference Time
+	int32_t				mDriftReferenceOffset;
+
+};	// TimeSync
+
+}	// microbit_dal_ext_kit
+
+#endif	// EXT_KIT_TIME_SYNC_H
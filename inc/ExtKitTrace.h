@@ -0,0 +1,93 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Trace utility
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#ifndef EXT_KIT_TRACE_H
+#define EXT_KIT_TRACE_H
+
+#include "ExtKit_Common.h"
+
+/// Record a trace with a format string and up to 4 integer arguments, without formatting it on the device
+/**
+	Example:
+	@code
+		EXT_KIT_TRACE("radio: sent %u bytes, rssi %d", length, rssi);
+	@endcode
+	Only the id of the format string, the Micro Time and the raw arguments are recorded into the trace buffer. The format string itself is not stored on the device.
+	`fmt` must be a string literal. Its id is computed at compile time, and the number of the arguments is checked against the conversions in it.
+	The conversions are the same as `string::format()`, except that `%s` records the pointer only.
+	The records are sent by `trace::sendRecords()` and decoded on the host by `tools/ExtKitTraceTool.cpp`, with the string table generated from the sources.
+*/
+#define EXT_KIT_TRACE(fmt, ...)	\
+	microbit_dal_ext_kit::trace::recordSite<	\
+		microbit_dal_ext_kit::trace::idForFormat(fmt),	\
+		microbit_dal_ext_kit::trace::conversionCount(fmt)>(__VA_ARGS__)
+
+namespace microbit_dal_ext_kit {
+
+/// Trace utility
+/**
+	A record consists of the following fields in little endian. It is 10 bytes plus 4 bytes for each argument.
+	- Sync byte `kRecordSync` (1 byte)
+	- Argument count (1 byte)
+	- Id of the format string (4 bytes)
+	- Micro Time in microseconds (4 bytes)
+	- Arguments (4 bytes each)
+*/
+namespace trace {
+
+/// Sync byte at the beginning of a record, which never appears in the text output
+const uint8_t kRecordSync = 0xa5;
+
+/// Size of the record header
+const int kRecordHeaderSize = 10;
+
+/// Max number of arguments in a record
+const int kArgCountMax = 4;
+
+/// Get the id for a format string, which is its 32-bit FNV-1a hash
+constexpr uint32_t idForFormat(const char* fmt, uint32_t hash = 2166136261u)
+{
+	return *fmt ? idForFormat(fmt + 1, (hash ^ (uint8_t) *fmt) * 16777619u) : hash;
+}
+
+/// Get the number of the conversions in a format string
+constexpr int conversionCount(const char* fmt)
+{
+	return !*fmt ? 0 :
+		(*fmt != '%') ? conversionCount(fmt + 1) :
+		(fmt[1] == '%') ? conversionCount(fmt + 2) :
+		1 + conversionCount(fmt + 1);
+}
+
+/// Record a trace into the trace buffer, overwriting the oldest records if the buffer is full. Not available in interrupt handlers.
+void record(uint32_t id, const uint32_t* args, int argCount);
+
+/// Record a trace for a log site. Use `EXT_KIT_TRACE()` instead.
+template<uint32_t kId, int kConversionCount, typename... Args>
+inline void recordSite(Args... args)
+{
+	static_assert(sizeof...(Args) == kConversionCount, "EXT_KIT_TRACE: the number of the arguments does not match the format");
+	static_assert(sizeof...(Args) <= kArgCountMax, "EXT_KIT_TRACE: too many arguments");
+
+	const uint32_t argArray[] = {0 /* for no arguments */, ((uint32_t) args)...};
+	record(kId, &argArray[1], sizeof...(Args));
+}
+
+/// Send the records in the trace buffer to the serial port as binary, and clear the buffer
+void sendRecords();
+
+/// Get the number of bytes in the trace buffer
+size_t bufferedSize();
+
+}	// trace
+}	// microbit_dal_ext_kit
+
+#endif	// EXT_KIT_TRACE_H
@@ -0,0 +1,157 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// WS2812 utility
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+	@note	This header does not depend on `microbit-dal`. The timing checks below are evaluated at compile time,
+			so compiling this header on a host (e.g., `g++ -std=c++11 -fsyntax-only -Iinc inc/ExtKitWs2812.h`) verifies them.
+*/
+
+#ifndef EXT_KIT_WS2812_H
+#define EXT_KIT_WS2812_H
+
+#include "ExtKit_Common.h"
+
+namespace microbit_dal_ext_kit {
+
+/// WS2812 utility - a portable encoder and a waveform model for WS2812B modules also known as %NeoPixel
+namespace ws2812 {
+
+/*
+	Bit timing specification in nanoseconds (WS2812B datasheet: nominal value +/- 150 ns)
+*/
+
+const uint32_t kT0HMin	= 250;	///< Min high duration for bit 0 (nominal 400 ns)
+const uint32_t kT0HMax	= 550;	///< Max high duration for bit 0
+const uint32_t kT0LMin	= 700;	///< Min low duration for bit 0 (nominal 850 ns)
+const uint32_t kT0LMax	= 1000;	///< Max low duration for bit 0
+const uint32_t kT1HMin	= 650;	///< Min high duration for bit 1 (nominal 800 ns)
+const uint32_t kT1HMax	= 950;	///< Max high duration for bit 1
+const uint32_t kT1LMin	= 300;	///< Min low duration for bit 1 (nominal 450 ns)
+const uint32_t kT1LMax	= 600;	///< Max low duration for bit 1
+
+/// Min low duration in microseconds to latch the data (reset code)
+const uint32_t kResetMinUs	= 50;
+
+/// Convert a count of cycles into nanoseconds for a clock frequency in kHz
+constexpr uint32_t nanosecondsFor(uint32_t cycles, uint32_t kHz)
+{
+	return cycles * 1000000 / kHz;
+}
+
+/// Check a pair of high and low durations for bit 0
+constexpr bool isValidBit0(uint32_t highNs, uint32_t lowNs)
+{
+	return (kT0HMin <= highNs) && (highNs <= kT0HMax) && (kT0LMin <= lowNs) && (lowNs <= kT0LMax);
+}
+
+/// Check a pair of high and low durations for bit 1
+constexpr bool isValidBit1(uint32_t highNs, uint32_t lowNs)
+{
+	return (kT1HMin <= highNs) && (highNs <= kT1HMax) && (kT1LMin <= lowNs) && (lowNs <= kT1LMax);
+}
+
+/// Waveform model of `sendBuffer()` in ExtKitNeoPixel.cpp
+/**
+	The cycles below are summed up from the Cortex-M0 instruction cycles along the paths of the inline assembly, in the same order as the instructions.
+	The assembly pads the byte boundary path with `kByteBoundaryNopCount` nops, so that a change in either path fails the checks below or is padded again.
+	Keep the sums in sync with the instructions when the assembly is changed.
+	@note	The high duration for bit 0 is 250 ns, which is exactly the min value of the WS2812B specification. There is no margin for one more cycle less.
+*/
+namespace sendBufferModel {
+
+/// CPU clock in kHz (nRF51822)
+const uint32_t kClockKHz				= 16000;
+
+/// Cycles of `str` and `ldrb`
+const uint32_t kCyclesMemory			= 2;
+
+/// Cycles of `tst`, `lsrs`, `adds`, `subs`, `movs` and `nop`
+const uint32_t kCyclesAlu				= 1;
+
+/// Cycles of `b` and a conditional branch taken
+const uint32_t kCyclesBranchTaken		= 3;
+
+/// Cycles of a conditional branch not taken
+const uint32_t kCyclesBranchNotTaken	= 1;
+
+/// Cycle at which the pin becomes high (`.nextbit`: `str` to reg_set)
+const uint32_t kCycleSetHigh	= kCyclesMemory;
+
+/// Cycle at which the pin becomes low for bit 0 (`tst`, `bne` not taken, `str` to reg_clr)
+const uint32_t kCycleClearFor0	= kCycleSetHigh + kCyclesAlu + kCyclesBranchNotTaken + kCyclesMemory;
+
+/// Cycle at which `.islate` is reached for bit 1 (`tst`, `bne` taken)
+const uint32_t kCycleIsLateFor1	= kCycleSetHigh + kCyclesAlu + kCyclesBranchTaken;
+
+/// Cycle at which `.common` is reached within a byte (`lsrs`, `bne .justbit` taken, `b .common`)
+const uint32_t kCycleCommonForBit	= kCycleClearFor0 + kCyclesAlu + kCyclesBranchTaken + kCyclesBranchTaken;
+
+/// Cycle at which `.common` is reached at a byte boundary without nops (`lsrs`, `bne` not taken, `adds`, `subs`, `bcc` not taken, `movs`)
+const uint32_t kCycleCommonForByte	= kCycleClearFor0 + kCyclesAlu + kCyclesBranchNotTaken + kCyclesAlu + kCyclesAlu + kCyclesBranchNotTaken + kCyclesAlu;
+
+/// Number of nops padding the byte boundary path in `.start`
+const uint32_t kByteBoundaryNopCount	= (kCycleCommonForBit - kCycleCommonForByte) / kCyclesAlu;
+
+/// Cycle at which the pin becomes low for bit 1 (`.common`: `str` to reg_clr)
+const uint32_t kCycleClearFor1	= kCycleCommonForBit + kCyclesMemory;
+
+/// Cycles per bit (`.common`: `ldrb`, `b .nextbit`)
+const uint32_t kCyclesPerBit	= kCycleClearFor1 + kCyclesMemory + kCyclesBranchTaken;
+
+static_assert(kCycleIsLateFor1 == kCycleClearFor0, "sendBuffer(): bit 0 and bit 1 must reach .islate at the same cycle");
+static_assert(kCycleCommonForByte <= kCycleCommonForBit, "sendBuffer(): the byte boundary path is too long to be padded");
+static_assert(kCycleCommonForByte + kByteBoundaryNopCount * kCyclesAlu == kCycleCommonForBit, "sendBuffer(): the byte boundary path cannot be padded exactly");
+
+/// High duration in nanoseconds for bit 0
+const uint32_t kT0H	= nanosecondsFor(kCycleClearFor0 - kCycleSetHigh, kClockKHz);
+
+/// Low duration in nanoseconds for bit 0
+const uint32_t kT0L	= nanosecondsFor(kCyclesPerBit - (kCycleClearFor0 - kCycleSetHigh), kClockKHz);
+
+/// High duration in nanoseconds for bit 1
+const uint32_t kT1H	= nanosecondsFor(kCycleClearFor1 - kCycleSetHigh, kClockKHz);
+
+/// Low duration in nanoseconds for bit 1
+const uint32_t kT1L	= nanosecondsFor(kCyclesPerBit - (kCycleClearFor1 - kCycleSetHigh), kClockKHz);
+
+static_assert(isValidBit0(kT0H, kT0L), "sendBuffer(): bit 0 timing is out of the WS2812B specification");	// kT0H == kT0HMin
+static_assert(isValidBit1(kT1H, kT1L), "sendBuffer(): bit 1 timing is out of the WS2812B specification");
+
+}	// sendBufferModel
+
+/// Symbols per data bit for encodeForSpi3()
+const int kSpi3SymbolsPerBit	= 3;
+
+/// Recommended SPI clock in kHz for encodeForSpi3()
+const uint32_t kSpi3ClockKHz	= 2400;
+
+static_assert(isValidBit0(nanosecondsFor(1, kSpi3ClockKHz), nanosecondsFor(2, kSpi3ClockKHz)), "encodeForSpi3(): bit 0 timing is out of the WS2812B specification");
+static_assert(isValidBit1(nanosecondsFor(2, kSpi3ClockKHz), nanosecondsFor(1, kSpi3ClockKHz)), "encodeForSpi3(): bit 1 timing is out of the WS2812B specification");
+
+/// Symbols per data bit for encodeForSpi4()
+const int kSpi4SymbolsPerBit	= 4;
+
+/// Recommended SPI clock in kHz for encodeForSpi4()
+const uint32_t kSpi4ClockKHz	= 3200;
+
+static_assert(isValidBit0(nanosecondsFor(1, kSpi4ClockKHz), nanosecondsFor(3, kSpi4ClockKHz)), "encodeForSpi4(): bit 0 timing is out of the WS2812B specification");
+static_assert(isValidBit1(nanosecondsFor(3, kSpi4ClockKHz), nanosecondsFor(1, kSpi4ClockKHz)), "encodeForSpi4(): bit 1 timing is out of the WS2812B specification");
+
+/// Encode GRB bytes into 3 SPI symbols per bit (`100` for bit 0 and `110` for bit 1), MSB first. `dst` requires `len * 3` bytes. Returns the encoded length.
+size_t encodeForSpi3(const uint8_t* src, size_t len, uint8_t* /* OUT */ dst);
+
+/// Encode GRB bytes into 4 SPI symbols per bit (`1000` for bit 0 and `1110` for bit 1), MSB first. `dst` requires `len * 4` bytes. Returns the encoded length.
+size_t encodeForSpi4(const uint8_t* src, size_t len, uint8_t* /* OUT */ dst);
+
+/// Encode GRB bytes into one PWM compare value per bit, MSB first. `dst` requires `len * 8` entries. Returns the encoded count.
+size_t encodeForPwm(const uint8_t* src, size_t len, uint16_t* /* OUT */ dst, uint16_t dutyFor0, uint16_t dutyFor1);
+
+}	// ws2812
+}	// microbit_dal_ext_kit
+
+#endif	// EXT_KIT_WS2812_H
@@ -33,6 +33,11 @@ namespace microbit_dal_ext_kit {
 				<td>The value is used for MicroBitRadio.setGroup()</td>
 				<td>0</td>
 			</tr>
+			<tr>
+				<td>YOTTA_CFG_MICROBIT_DAL__EXT_KIT_REMOTE_STATE_BINARY</td>
+				<td>remoteState::Transmitter and remoteState::Receiver send binary frames instead of text commands by default if the value is 1</td>
+				<td>0</td>
+			</tr>
 			<tr>
 				<td>YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_EXT_DEBUG</td>
 				<td>Serial Debugger is enabled if the value is 1</td>
@@ -48,6 +53,16 @@ namespace microbit_dal_ext_kit {
 				<td>The value is used for MicroBitSerial.setTxBufferSize()</td>
 				<td>80</td>
 			</tr>
+			<tr>
+				<td>YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_TXQUEUE</td>
+				<td>The size in bytes of the serial TX queue, which is drained by a fiber. The queue is disabled if the value is 0</td>
+				<td>256</td>
+			</tr>
+			<tr>
+				<td>YOTTA_CFG_MICROBIT_DAL__EXT_KIT_TRACE_BUFFER</td>
+				<td>The size in bytes of the trace buffer for EXT_KIT_TRACE(). The trace is disabled if the value is 0</td>
+				<td>256</td>
+			</tr>
 		</table>
 		These default values are defined in <a href=_ext_kit___config_8h_source.html>ExtKit_Config.h</a>.
 
@@ -72,6 +87,11 @@ namespace microbit_dal_ext_kit {
 #define		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_RADIO_GROUP			0
 #endif	//	YOTTA_CFG_MICROBIT_DAL__EXT_KIT_RADIO_GROUP
 
+/// Ensure that the config feature for using the binary frames for remote state is defined. The valid value is 1 (enabled) or 0 (disabled).
+#ifndef		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_REMOTE_STATE_BINARY
+#define		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_REMOTE_STATE_BINARY	0
+#endif	//	YOTTA_CFG_MICROBIT_DAL__EXT_KIT_REMOTE_STATE_BINARY
+
 /// Ensure that the config feature for usig the serial external debugger is defined. The valid value is 1 (enabled) or 0 (disabled).
 #ifndef		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_EXT_DEBUG
 #define		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_EXT_DEBUG	1
@@ -87,6 +107,16 @@ namespace microbit_dal_ext_kit {
 #define		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_TXBUF		80
 #endif	//	YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_TXBUF
 
+/// Ensure that the config value for the size of the serial tx queue is defined. The valid value is 0 (disabled) or a number of bytes.
+#ifndef		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_TXQUEUE
+#define		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_TXQUEUE		256
+#endif	//	YOTTA_CFG_MICROBIT_DAL__EXT_KIT_SERIAL_TXQUEUE
+
+/// Ensure that the config value for the size of the trace buffer is defined. The valid value is 0 (disabled) or a number of bytes.
+#ifndef		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_TRACE_BUFFER
+#define		YOTTA_CFG_MICROBIT_DAL__EXT_KIT_TRACE_BUFFER		256
+#endif	//	YOTTA_CFG_MICROBIT_DAL__EXT_KIT_TRACE_BUFFER
+
 /// Check that the config feature is enabled
 #define EXT_KIT_CONFIG_ENABLED(xxx)		(YOTTA_CFG_MICROBIT_DAL__EXT_KIT_##xxx == 1)	// expects 0 or 1
 
@@ -61,11 +61,17 @@ namespace microbit_dal_ext_kit {
 		</td></tr><tr><td>
 		PeriodicObserver			</td><td>	@copybrief	PeriodicObserver
 		</td></tr><tr><td>
+		radio::LoopbackTransport	</td><td>	@copybrief	radio::LoopbackTransport
+		</td></tr><tr><td>
 		remoteState::Transmitter	</td><td>	@copybrief	remoteState::Transmitter
 		</td></tr><tr><td>
 		remoteState::Receiver		</td><td>	@copybrief	remoteState::Receiver
 		</td></tr><tr><td>
+		remoteState::Relay			</td><td>	@copybrief	remoteState::Relay
+		</td></tr><tr><td>
 		SerialDebugger				</td><td>	@copybrief	SerialDebugger
+		</td></tr><tr><td>
+		TimeSync					</td><td>	@copybrief	TimeSync
 		</td></tr></table>
 */
 
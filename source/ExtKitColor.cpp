@@ -145,4 +145,33 @@ Color::Color(uint16_t /* 360 */ whole, uint16_t /* hue level (e.g., 0-359) */ h,
 	}
 }
 
+Color Color::fromHsv(uint8_t /* hue level (0-255) */ h, uint8_t /* saturation level */ s, uint8_t /* value (brightness) level */ v)
+{
+	if(s == 0) {
+		// grayscale
+		return Color(v, v, v);
+	}
+
+	uint16_t h6		= h * 6;		// range: 0 - 0x5fa
+	uint8_t region	= h6 >> 8;		// range: 0 - 5
+	uint8_t hh		= (uint8_t) h6;	// range: 0 - 0xff
+
+	uint8_t p		= 0xff - s;
+	uint8_t q		= 0xff - ((s * hh) >> 8);
+	uint8_t t		= 0xff - ((s * (0xff - hh)) >> 8);
+	p = (p * v) >> 8;
+	q = (q * v) >> 8;
+	t = (t * v) >> 8;
+
+	switch(region) {
+		default:
+		case 0:		return Color(v, t, p);	// v (r) + t + p
+		case 2:		return Color(p, v, t);	// v (g) + t + p
+		case 4:		return Color(t, p, v);	// v (b) + t + p
+		case 1:		return Color(q, v, p);	// v (g) + p + q
+		case 3:		return Color(p, q, v);	// v (b) + p + q
+		case 5:		return Color(v, p, q);	// v (r) + p + q
+	}
+}
+
 }	// microbit_dal_ext_kit
@@ -14,6 +14,12 @@
 
 namespace microbit_dal_ext_kit {
 
+/// Size of the buffer for the debug prefix, e.g., "@4294967295 +4294967295\t"
+static const size_t kDebugPrefixSize = 32;
+
+/// Size of the buffer for a line formatted by debug_sendFormat()
+static const size_t kDebugLineSize = 128;
+
 static bool sIsDebuggerActive = false;
 
 void debug_activateDebugger(bool activate)
@@ -43,23 +49,35 @@ void debug_sendLine(bool withDebugPrefix, const char* suffix, const char* s1, co
 		return;
 	}
 
+	// Send the line as a whole, so that it is not interleaved with the lines of the other fibers
 	if(withDebugPrefix) {
 		static time::SystemTime lastTime = 0;
 		time::SystemTime time = time::systemTime();
 		time::SystemTime diff = time - lastTime;
-		serial::send("@");
-		serial::send((int) time);
-		serial::send(" +");
-		serial::send((int) diff);
-		serial::send("\t");
 		lastTime = time;
+		char prefix[kDebugPrefixSize];
+		string::format(prefix, sizeof(prefix), "@%d +%d\t", (int) time, (int) diff);
+		const char* strings[] = {prefix, s1, s2, s3, s4, s5, suffix};
+		serial::sendAll(strings, sizeof(strings) / sizeof(strings[0]));
+	}
+	else {
+		const char* strings[] = {s1, s2, s3, s4, s5, suffix};
+		serial::sendAll(strings, sizeof(strings) / sizeof(strings[0]));
 	}
-	serial::send(s1);
-	serial::send(s2);
-	serial::send(s3);
-	serial::send(s4);
-	serial::send(s5);
-	serial::send(suffix);
+}
+
+void debug_sendFormat(const char* fmt, ...)
+{
+	if(!sIsDebuggerActive) {
+		return;
+	}
+
+	char line[kDebugLineSize];
+	va_list args;
+	va_start(args, fmt);
+	string::formatV(line, sizeof(line), fmt, args);
+	va_end(args);
+	debug_sendLine(true, "\r\n", line);
 }
 
 void debug_sendMemoryDump(const void* buffer, size_t length)
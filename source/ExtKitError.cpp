@@ -17,11 +17,14 @@ namespace error {
 
 void raise(const char *desc, const char *file, int line, int panicCode)
 {
-	serial::send(desc);
-	serial::send(", file: ");
-	serial::send(file);
-	serial::send(", line: ");
-	serial::sendLine(line);
+	// Send directly, since the message would be dropped if the TX queue is full
+	char lineString[16];
+	string::format(lineString, sizeof(lineString), "%d\r\n", line);
+	serial::sendUnqueued(desc);
+	serial::sendUnqueued(", file: ");
+	serial::sendUnqueued(file);
+	serial::sendUnqueued(", line: ");
+	serial::sendUnqueued(lineString);
 
 	if(panicCode) {
 		microbit_panic(panicCode);
@@ -36,11 +39,13 @@ void raise(const char *desc, const char *file, int line, int panicCode)
 
 void raise(const char *desc, const char* name, const void* object, int panicCode)
 {
-	serial::send(desc);
-	serial::send(", name: ");
-	serial::send(name);
-	serial::send(", object: 0x");
-	serial::sendLine(string::hex((uint32_t) object).toCharArray());
+	// Send directly, since the message would be dropped if the TX queue is full
+	serial::sendUnqueued(desc);
+	serial::sendUnqueued(", name: ");
+	serial::sendUnqueued(name);
+	serial::sendUnqueued(", object: 0x");
+	serial::sendUnqueued(string::hex((uint32_t) object).toCharArray());
+	serial::sendUnqueued("\r\n");
 
 	if(panicCode) {
 		microbit_panic(panicCode);
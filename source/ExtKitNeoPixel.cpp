@@ -14,6 +14,21 @@
 
 namespace microbit_dal_ext_kit {
 
+static const int kBytesPerLed = 3;	// bytes per one led module
+
+static const uint8_t* sendBuffer(MicroBitPin* pin, const uint8_t* buf, int len);
+static int colorDistance(uint8_t a, uint8_t b);
+
+//																			 123456789abcdef0
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsCurrent,			"\x10", " Current (mA):  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsCurrentLimited,	"\x10", " CurrentLimited:")
+
+/// Default current per channel step in microamperes (about 20 mA for level 0xff)
+static const uint16_t kMicroAmperesPerStepDefault		= 78;
+
+/// Default idle current per led module in microamperes
+static const uint16_t kIdleMicroAmperesPerLedDefault	= 1000;
+
 /**	@class	NeoPixel
 	@reference	ws2812
 		- https://makecode.microbit.org/pkg/Microsoft/pxt-ws2812b
@@ -22,21 +37,25 @@ namespace microbit_dal_ext_kit {
 		- https://github.com/Microsoft/pxt-ws2812b/blob/master/sendBuffer.asm
 */
 
-static const int kBytesPerLed = 3;	// bytes per one led module
-
-static const uint8_t* sendBuffer(MicroBitPin* pin, const uint8_t* buf, int len);
-
-NeoPixel::NeoPixel(const char* name, MicroBitPin& ledPort, int ledCount)
+NeoPixel::NeoPixel(const char* name, MicroBitPin& ledPort, int ledCount, PaletteMode paletteMode, int paletteSize)
 	: Component(name)
 	, mLedPort(ledPort)
 	, mLedCount(0)
-	, mLedHueUnit(0)
+	, mPaletteMode(paletteMode)
+	, mPaletteSize(0)
 	, mLedBufferLength(0)
 	, mLedBuffer(0)
-	, mMaxBrightness(NeoPixel::kMaxBrightnessNoLimit)
-	, mColorMode(kManual)
-	, mIndicatorPattern(0)
-	, mFocusDirection(direction::kInvalid)
+	, mPalette(0)
+	, mOutputBufferLength(0)
+	, mOutputBuffer(0)
+	, mGroupCount(0)
+	, mMicroAmperesPerStep(kMicroAmperesPerStepDefault)
+	, mIdleMicroAmperesPerLed(kIdleMicroAmperesPerLedDefault)
+	, mCurrentBudget(0)
+	, mEstimatedCurrent(0)
+	, mStatisticsCurrent(ManagedString(name) + ManagedString(sStatisticsCurrent))
+	, mStatisticsCurrentLimited(ManagedString(name) + ManagedString(sStatisticsCurrentLimited))
+	, mWholeSegment(*this, ledCount)
 {
 	EXT_KIT_ASSERT(0 < ledCount);
 
@@ -49,21 +68,47 @@ NeoPixel::NeoPixel(const char* name, MicroBitPin& ledPort, int ledCount)
 //	debug_dumpPin(&mLedPort);
 
 	mLedCount = ledCount;
-	mLedHueUnit = 360 / ledCount;
-	mLedBufferLength = ledCount * kBytesPerLed;
-	mLedBuffer = new uint8_t[mLedBufferLength * 2];	// consists of two buffers with and without brightness control
+	mOutputBufferLength = ledCount * kBytesPerLed;
+	if(paletteMode == kPaletteNone) {
+		mLedBufferLength = ledCount * kBytesPerLed;
+	}
+	else {
+		EXT_KIT_ASSERT((paletteMode == kPalette4Bits) || (paletteMode == kPalette8Bits));
+
+		int maxPaletteSize = 1 << paletteMode;
+		mPaletteSize = ((0 < paletteSize) && (paletteSize < maxPaletteSize)) ? paletteSize : maxPaletteSize;
+		mLedBufferLength = (paletteMode == kPalette4Bits) ? (ledCount + 1) / 2 : ledCount;
+	}
+	int paletteLength = mPaletteSize * kBytesPerLed;
+
+	// consists of the led buffer, the palette (optional) and the output buffer with brightness control
+	mLedBuffer = new uint8_t[mLedBufferLength + paletteLength + mOutputBufferLength];
 	EXT_KIT_ASSERT_OR_PANIC(mLedBuffer, panic::kOutOfMemory);
+
+	if(mPaletteSize) {
+		memset(mLedBuffer, 0, mLedBufferLength + paletteLength);
+		mPalette = &mLedBuffer[mLedBufferLength];
+	}
+	mOutputBuffer = &mLedBuffer[mLedBufferLength + paletteLength];
 }
 
 NeoPixel::~NeoPixel()
 {
-	delete mLedBuffer;
+	EXT_KIT_ASSERT(mSegmentRoot.next == &mSegmentRoot);	// segments would be left with a dangling strip
+	EXT_KIT_ASSERT(mGroupCount == 0);					// groups would be left with a dangling strip
+
+	delete[] mLedBuffer;
 }
 
 /* Component */ void NeoPixel::doHandleComponentAction(Action action)
 {
 	if(action == kStart) {
-		fillColor(Color::black);
+		if(mPalette) {
+			fillColorIndex(0);
+		}
+		else {
+			fillColor(Color::black);
+		}
 		show();
 	}
 
@@ -72,14 +117,73 @@ NeoPixel::~NeoPixel()
 
 void NeoPixel::show()
 {
-	uint8_t* src = &mLedBuffer[0];
-	uint8_t* dst = &mLedBuffer[mLedBufferLength];
-	for(int i = 0; i < mLedCount; i++) {
+	prepareOutput();
+
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::show");
+
+//	debug_sendLine(EXT_KIT_DEBUG_INFO "NeoPixel::mLedBuffer");
+//	debug_sendMemoryDump(mLedBuffer, mLedBufferLength);
+//	debug_sendMemoryDump(mOutputBuffer, mOutputBufferLength);
+
+//	debug_sendLine(EXT_KIT_DEBUG_INFO "NeoPixel::mLedPort");
+//	debug_dumpPin(&mLedPort);
+
+	__disable_irq();
+	sendOutput();
+	__enable_irq();
+}
+
+void NeoPixel::prepareOutput()
+{
+	// Apply max brightness and sum up the output levels in the same pass
+	MaxBrightness maxBrightness = mWholeSegment.mMaxBrightness;
+	uint32_t level = prepareOutput(0, mLedCount, maxBrightness);
+
+	Node* p = &mSegmentRoot;
+	while((p = p->next) != &mSegmentRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		SegmentRecord* r = static_cast<SegmentRecord*>(p);
+		NeoPixelSegment& segment = r->segment;
+		if(segment.mMaxBrightness < maxBrightness) {	// the segment caps the strip
+			uint32_t replacedLevel = 0;
+			level += prepareOutput(segment.mFirst, segment.mLedCount, segment.mMaxBrightness, &replacedLevel);
+			level -= replacedLevel;
+		}
+	}
+
+	// Apply the current budget
+	uint32_t idleCurrent = (uint32_t) mIdleMicroAmperesPerLed * mLedCount;	// in microamperes
+	uint32_t activeCurrent = level * mMicroAmperesPerStep;						// in microamperes
+	uint32_t budget = (uint32_t) mCurrentBudget * 1000;						// in microamperes
+	if(budget && (budget < idleCurrent + activeCurrent)) {
+		// 64-bit intermediates, since shifting or scaling microamperes overflows 32 bits above about 16.7 A
+		uint32_t factor = (idleCurrent < budget) ? (uint32_t) (((uint64_t) (budget - idleCurrent) << 8) / activeCurrent) : 0;	// in 1/256, less than 256
+		scaleOutput(factor);
+		activeCurrent = (uint32_t) ((uint64_t) activeCurrent * factor >> 8);
+		Statistics::incrementItem(mStatisticsCurrentLimited);
+	}
+
+	mEstimatedCurrent = (idleCurrent + activeCurrent) / 1000;
+	Statistics::setItem(mStatisticsCurrent, mEstimatedCurrent);
+}
+
+uint32_t NeoPixel::prepareOutput(int first, int ledCount, MaxBrightness maxBrightness, uint32_t* /* OUT */ replacedLevel)
+{
+	const uint8_t* src = &mLedBuffer[first * kBytesPerLed];
+	uint8_t* dst = &mOutputBuffer[first * kBytesPerLed];
+	uint32_t maxPower = 0xFF * 3 * maxBrightness / kMaxBrightnessNoLimit;
+	uint32_t level = 0;
+	uint32_t replaced = 0;
+	for(int i = 0; i < ledCount; i++) {
+		if(mPalette) {
+			// expand the palette index on the fly
+			src = &mPalette[colorIndexAt(first + i) * kBytesPerLed];
+		}
 		uint8_t g	= *src++;
 		uint8_t r	= *src++;
 		uint8_t b	= *src++;
 		uint32_t power = g + r + b;	// range: 0 - 765
-		uint32_t maxPower = 0xFF * 3 * mMaxBrightness / kMaxBrightnessNoLimit;
 		if(maxPower < power) {
 			if(0 < g) {
 				g = g * maxPower / power;
@@ -100,52 +204,481 @@ void NeoPixel::show()
 				}
 			}
 		}
+		if(replacedLevel) {
+			replaced += dst[0] + dst[1] + dst[2];
+		}
+		level += g + r + b;
 		*dst++ = g;
 		*dst++ = r;
 		*dst++ = b;
 	}
+	if(replacedLevel) {
+		*replacedLevel = replaced;
+	}
+	return level;
+}
 
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::show");
+void NeoPixel::scaleOutput(uint16_t factor)
+{
+	uint8_t* p = mOutputBuffer;
+	for(int i = 0; i < mOutputBufferLength; i++) {
+		*p = (*p * factor) >> 8;
+		p++;
+	}
+}
 
-//	debug_sendLine(EXT_KIT_DEBUG_INFO "NeoPixel::mLedBuffer");
-//	debug_sendMemoryDump(&mLedBuffer[0], mLedBufferLength);
-//	debug_sendMemoryDump(&mLedBuffer[mLedBufferLength], mLedBufferLength);
+void NeoPixel::sendOutput()
+{
+	sendBuffer(&mLedPort, mOutputBuffer, mOutputBufferLength);
+}
 
-//	debug_sendLine(EXT_KIT_DEBUG_INFO "NeoPixel::mLedPort");
-//	debug_dumpPin(&mLedPort);
+uint8_t NeoPixel::colorIndexAt(int ledIndex)
+{
+	if(mPaletteMode == kPalette4Bits) {
+		uint8_t v = mLedBuffer[ledIndex >> 1];
+		return (ledIndex & 1) ? (v & 0xf) : (v >> 4);
+	}
+	return mLedBuffer[ledIndex];
+}
+
+void NeoPixel::setColorIndexAt(int ledIndex, uint8_t paletteIndex)
+{
+	EXT_KIT_ASSERT(paletteIndex < mPaletteSize);
 
-	sendBuffer(&mLedPort, &mLedBuffer[mLedBufferLength], mLedBufferLength);
+	if(mPaletteMode == kPalette4Bits) {
+		uint8_t* p = &mLedBuffer[ledIndex >> 1];
+		*p = (ledIndex & 1) ? ((*p & 0xf0) | paletteIndex) : ((*p & 0x0f) | (paletteIndex << 4));
+		return;
+	}
+	mLedBuffer[ledIndex] = paletteIndex;
 }
 
 void NeoPixel::setMaxBrightness(NeoPixel::MaxBrightness limit)
 {
-	mMaxBrightness = numeric::clamp(kMaxBrightnessLowest, kMaxBrightnessNoLimit, limit);
+	mWholeSegment.setMaxBrightness(limit);
 }
 
 void NeoPixel::changeMaxBrightness(int offset)
 {
-	setMaxBrightness(mMaxBrightness + offset);
+	mWholeSegment.changeMaxBrightness(offset);
 }
 
 NeoPixel::MaxBrightness NeoPixel::maxBrightness()
 {
-	return mMaxBrightness;
+	return mWholeSegment.maxBrightness();
+}
+
+void NeoPixel::setCurrentModel(uint16_t microAmperesPerStep, uint16_t idleMicroAmperesPerLed)
+{
+	mMicroAmperesPerStep = microAmperesPerStep;
+	mIdleMicroAmperesPerLed = idleMicroAmperesPerLed;
+}
+
+void NeoPixel::setCurrentBudget(uint16_t milliAmperes)
+{
+	mCurrentBudget = milliAmperes;
+}
+
+uint16_t NeoPixel::estimatedCurrent()
+{
+	return mEstimatedCurrent;
+}
+
+void NeoPixel::setPaletteColor(int paletteIndex, Color color)
+{
+	EXT_KIT_ASSERT(mPalette);
+	EXT_KIT_ASSERT(0 <= paletteIndex);
+	EXT_KIT_ASSERT(paletteIndex < mPaletteSize);
+
+	uint8_t* p = &mPalette[paletteIndex * kBytesPerLed];
+	*p++ = color.g();
+	*p++ = color.r();
+	*p++ = color.b();
+}
+
+Color NeoPixel::paletteColor(int paletteIndex)
+{
+	EXT_KIT_ASSERT(mPalette);
+	EXT_KIT_ASSERT(0 <= paletteIndex);
+	EXT_KIT_ASSERT(paletteIndex < mPaletteSize);
+
+	uint8_t* p = &mPalette[paletteIndex * kBytesPerLed];
+	uint8_t g = *p++;
+	uint8_t r = *p++;
+	uint8_t b = *p++;
+	return Color(r, g, b);
+}
+
+void NeoPixel::rotatePaletteLeft()
+{
+	EXT_KIT_ASSERT(mPalette);
+
+	if(mPaletteSize <= 1) {
+		return;
+	}
+
+	uint8_t* src = mPalette;
+	uint8_t* dst = mPalette;
+	const uint8_t v1 = *src++;
+	const uint8_t v2 = *src++;
+	const uint8_t v3 = *src++;
+	for(int i = 1; i < mPaletteSize; i++) {
+		*dst++ = *src++;
+		*dst++ = *src++;
+		*dst++ = *src++;
+	}
+	*dst++ = v1;
+	*dst++ = v2;
+	*dst++ = v3;
+}
+
+void NeoPixel::rotatePaletteRight()
+{
+	EXT_KIT_ASSERT(mPalette);
+
+	if(mPaletteSize <= 1) {
+		return;
+	}
+
+	uint8_t* src = &mPalette[mPaletteSize * kBytesPerLed];
+	uint8_t* dst = src;
+	const uint8_t v1 = *(--src);
+	const uint8_t v2 = *(--src);
+	const uint8_t v3 = *(--src);
+	for(int i = 1; i < mPaletteSize; i++) {
+		*(--dst) = *(--src);
+		*(--dst) = *(--src);
+		*(--dst) = *(--src);
+	}
+	*(--dst) = v1;
+	*(--dst) = v2;
+	*(--dst) = v3;
+}
+
+void NeoPixel::fillColorIndex(uint8_t paletteIndex)
+{
+	mWholeSegment.fillColorIndex(paletteIndex);
+}
+
+void NeoPixel::setColorIndex(int index, uint8_t paletteIndex)
+{
+	mWholeSegment.setColorIndex(index, paletteIndex);
+}
+
+uint8_t NeoPixel::colorIndex(int index)
+{
+	return mWholeSegment.colorIndex(index);
 }
 
 void NeoPixel::fillColor(Color color)
 {
 //	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::fillColor");
 
+	mWholeSegment.fillColor(color);
+}
+
+void NeoPixel::fillColorWithRainbow()
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::fillColorWithRainbow");
+
+	mWholeSegment.fillColorWithRainbow();
+}
+
+void NeoPixel::fillColorWithHueGradient(int index, int count, uint16_t startHue, uint16_t hueStep, uint8_t s, uint8_t v)
+{
+	mWholeSegment.fillColorWithHueGradient(index, count, startHue, hueStep, s, v);
+}
+
+void NeoPixel::setColor(int index, Color color)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setColor");
+
+	mWholeSegment.setColor(index, color);
+}
+
+Color NeoPixel::color(int index)
+{
+	return mWholeSegment.color(index);
+}
+
+void NeoPixel::rotateLeft()
+{
+	mWholeSegment.rotateLeft();
+}
+
+void NeoPixel::rotateRight()
+{
+	mWholeSegment.rotateRight();
+}
+
+void NeoPixel::setColorMapForIndicator(Color colorOff, Color colorOn)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setColorMapForIndicator");
+
+	mWholeSegment.setColorMapForIndicator(colorOff, colorOn);
+}
+
+void NeoPixel::fillColorWithIndicatorPattern(uint32_t indicatorPattern)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::fillColorWithIndicatorPattern: 0x", string::hex(indicatorPattern).toCharArray());
+
+	mWholeSegment.fillColorWithIndicatorPattern(indicatorPattern);
+}
+
+void NeoPixel::setColorMapForFocus(Color colorOff, Color colorOn1, Color colorOn2, Color colorOn3)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setColorMapForFocus");
+
+	mWholeSegment.setColorMapForFocus(colorOff, colorOn1, colorOn2, colorOn3);
+}
+
+void NeoPixel::setRainbowMapForFocus()
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setRainbowMapForFocus");
+
+	mWholeSegment.setRainbowMapForFocus();
+}
+
+void NeoPixel::fillColorWithFocusDirection(Direction focusDirection)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::fillColorWithFocusDirection: 0x", string::hex(focusDirection).toCharArray());
+
+	mWholeSegment.fillColorWithFocusDirection(focusDirection);
+}
+
+void NeoPixel::debug_sendBenchmark(int repeatCount)
+{
+	EXT_KIT_ASSERT(0 < repeatCount);
+
+	if(mPalette) {
+		debug_sendLine(EXT_KIT_DEBUG_INFO "NeoPixel benchmark: not available in palette mode");
+		return;
+	}
+
+	// Per-LED hsv constructor with a 360-degree hue circle
+	time::MicroTime start = time::microTime();
+	for(int n = 0; n < repeatCount; n++) {
+		for(int i = 0; i < mLedCount; i++) {
+			mWholeSegment.setColorDirectly(i, Color(360, i * 360 / mLedCount, 0xff, 0xff));
+		}
+	}
+	time::MicroTime durationForConstructor = time::microTime() - start;
+
+	// Batch hue gradient with a 256-step hue circle
+	start = time::microTime();
+	for(int n = 0; n < repeatCount; n++) {
+		mWholeSegment.fillColorWithHueGradientDirectly(0, mLedCount, 0, 0x10000 / mLedCount, 0xff, 0xff);
+	}
+	time::MicroTime durationForGradient = time::microTime() - start;
+
+	debug_sendLine(EXT_KIT_DEBUG_INFO "NeoPixel benchmark: leds x repeats = ", ManagedString(mLedCount).toCharArray(), " x ", ManagedString(repeatCount).toCharArray());
+	debug_sendLine(EXT_KIT_DEBUG_INFO "- Color(360, h, s, v) per led [us]: ", ManagedString((int) durationForConstructor).toCharArray());
+	debug_sendLine(EXT_KIT_DEBUG_INFO "- fillColorWithHueGradient() [us]:  ", ManagedString((int) durationForGradient).toCharArray());
+}
+
+void NeoPixel::attachSegment(NeoPixelSegment& segment)
+{
+	Node* p = new SegmentRecord(segment);
+	EXT_KIT_ASSERT_OR_PANIC(p, panic::kOutOfMemory);
+
+	p->linkBefore(mSegmentRoot);
+}
+
+void NeoPixel::detachSegment(NeoPixelSegment& segment)
+{
+	Node* p = &mSegmentRoot;
+	while((p = p->next) != &mSegmentRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		SegmentRecord* r = static_cast<SegmentRecord*>(p);
+		if(&(r->segment) == &segment) {
+			r->unlink();
+			delete r;
+			break;
+		}
+	}
+}
+
+void NeoPixel::debug_dumpPin(MicroBitPin* pin)
+{
+	debug_sendMemoryDump(pin, sizeof(MicroBitPin) /* 16 */);
+	void** array = (void**) pin;
+	debug_sendMemoryDump(array[2], sizeof(DigitalOut) /* 24 */);
+}
+
+/*
+	An output example of NeoPixel::debug_dumpPin() for P1
+*/
+
+//	ec 21 00 20:  78 32 02 00  08 00 02 00  e8 29 00 20  0f 01 02 00
+
+#if 0
+#include "MicroBitComponent.h"
+	class MicroBitComponent {
+		void*			vtable;		// [0] 78 32 02 00
+		uint16_t		id;			// [4] 08 00 (MICROBIT_ID_IO_P1)
+		uint8_t			status;		// [6] 02    (IO_STATUS_DIGITAL_OUT)
+									// [7] 00    (padding)
+	};								// [8]
+
+#include "TARGET_MCU_NRF51822/TARGET_NRF51_MICROBIT/PinNames.h"
+#include "MicroBitPin.h"
+	class MicroBitPin : public MicroBitComponent {
+		void*			pin;		// [8]  e8 29 00 20 (DigitalOut*)
+		PinCapability	capability;	// [12] 0f    (PIN_CAPABILITY_ALL)
+		uint8_t			pullMode;	// [13] 01     (PullDown)
+		PinName			name;		// [14] 02 00 (MICROBIT_PIN_P1=P0_2=p2)
+	};								// [16]
+#endif	// 0
+
+//	e8 29 00 20:  02 00 00 00  04 00 00 00  14 05 00 50  08 05 00 50
+//	f8 29 00 20:  0c 05 00 50  10 05 00 50
+
+#if 0
+#include "TARGET_MCU_NRF51822/gpio_object.h"
+	typedef struct {
+		PinName			pin;		// [0]  02 00 (MICROBIT_PIN_P1=P0_2=p2)
+									// [2]  00 00 (padding)
+		uint32_t		mask;		// [4]  04 00 00 00 -> r1 in sendBuffer()
+		__IO uint32_t*	reg_dir;	// [8]  14 05 00 50
+		__IO uint32_t*	reg_set;	// [12] 08 05 00 50 -> r3 in sendBuffer()
+		__IO uint32_t*	reg_clr;	// [16] 0c 05 00 50 -> r2 in sendBuffer()
+		__I  uint32_t*	reg_in;		// [20] 10 05 00 50
+	} gpio_t;						// [24]
+
+#include "DigitalOut.h"
+	class DigitalOut {
+		gpio_t			gpio;		// [0]
+	};								// [24]
+#endif	// 0
+
+/**	@class	NeoPixelSegment
+*/
+
+NeoPixelSegment::NeoPixelSegment(NeoPixel& strip, int first, int ledCount)
+	: mStrip(strip)
+	, mFirst(first)
+	, mLedCount(ledCount)
+	, mAttached(true)
+	, mMaxBrightness(NeoPixel::kMaxBrightnessNoLimit)
+	, mPaletteFirst(0)
+	, mPaletteCount(0)
+	, mColorMode(kManual)
+	, mIndicatorPattern(0)
+	, mFocusDirection(direction::kInvalid)
+{
+	EXT_KIT_ASSERT(0 <= first);
+	EXT_KIT_ASSERT(0 < ledCount);
+	EXT_KIT_ASSERT(first + ledCount <= strip.mLedCount);
+
+	mStrip.attachSegment(*this);
+}
+
+NeoPixelSegment::NeoPixelSegment(NeoPixel& strip, int ledCount)
+	: mStrip(strip)
+	, mFirst(0)
+	, mLedCount(ledCount)
+	, mAttached(false)
+	, mMaxBrightness(NeoPixel::kMaxBrightnessNoLimit)
+	, mPaletteFirst(0)
+	, mPaletteCount(0)
+	, mColorMode(kManual)
+	, mIndicatorPattern(0)
+	, mFocusDirection(direction::kInvalid)
+{
+	EXT_KIT_ASSERT(0 < ledCount);
+}
+
+NeoPixelSegment::~NeoPixelSegment()
+{
+	if(mAttached) {
+		mStrip.detachSegment(*this);
+	}
+}
+
+void NeoPixelSegment::show()
+{
+	mStrip.show();
+}
+
+void NeoPixelSegment::setMaxBrightness(MaxBrightness limit)
+{
+	mMaxBrightness = numeric::clamp(NeoPixel::kMaxBrightnessLowest, NeoPixel::kMaxBrightnessNoLimit, limit);
+}
+
+void NeoPixelSegment::changeMaxBrightness(int offset)
+{
+	setMaxBrightness(mMaxBrightness + offset);
+}
+
+NeoPixelSegment::MaxBrightness NeoPixelSegment::maxBrightness()
+{
+	return mMaxBrightness;
+}
+
+void NeoPixelSegment::setPaletteRange(int first, int count)
+{
+	EXT_KIT_ASSERT(mStrip.mPalette);
+	EXT_KIT_ASSERT(0 <= first);
+	EXT_KIT_ASSERT(0 < count);
+	EXT_KIT_ASSERT(first + count <= mStrip.mPaletteSize);
+
+	// The ranges set for the segments must be disjoint, since the color modes rewrite the palette colors in them
+	Node* p = &mStrip.mSegmentRoot;
+	while((p = p->next) != &mStrip.mSegmentRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		NeoPixelSegment& segment = static_cast<NeoPixel::SegmentRecord*>(p)->segment;
+		if((&segment != this) && segment.mPaletteCount) {
+			EXT_KIT_ASSERT((first + count <= segment.mPaletteFirst) || (segment.mPaletteFirst + segment.mPaletteCount <= first));
+		}
+	}
+
+	mPaletteFirst = first;
+	mPaletteCount = count;
+}
+
+int NeoPixelSegment::paletteCount()
+{
+	return mPaletteCount ? mPaletteCount : mStrip.mPaletteSize;
+}
+
+uint8_t NeoPixelSegment::paletteIndexForColor(Color color)
+{
+	int nearestIndex = mPaletteFirst;
+	int nearestDistance = 0x300;	// larger than any distance
+	int count = paletteCount();
+	for(int i = mPaletteFirst; i < mPaletteFirst + count; i++) {
+		Color c = mStrip.paletteColor(i);
+		int distance = colorDistance(c.r(), color.r()) + colorDistance(c.g(), color.g()) + colorDistance(c.b(), color.b());
+		if(distance < nearestDistance) {
+			nearestIndex = i;
+			nearestDistance = distance;
+			if(distance == 0) {
+				break;
+			}
+		}
+	}
+	return nearestIndex;
+}
+
+void NeoPixelSegment::fillColor(Color color)
+{
 	fillColorDirectly(color);
 	mColorMode = kManual;
 }
 
-void NeoPixel::fillColorDirectly(Color color)
+void NeoPixelSegment::fillColorDirectly(Color color)
 {
+	if(mStrip.mPalette) {
+		fillColorIndexDirectly(paletteIndexForColor(color));
+		return;
+	}
+
 	const uint8_t g	= color.g();
 	const uint8_t r	= color.r();
 	const uint8_t b	= color.b();
-	uint8_t* p = mLedBuffer;
+	uint8_t* p = &mStrip.mLedBuffer[mFirst * kBytesPerLed];
 	for(int i = 0; i < mLedCount; i++) {
 		*p++ = g;
 		*p++ = r;
@@ -153,55 +686,179 @@ void NeoPixel::fillColorDirectly(Color color)
 	}
 }
 
-void NeoPixel::fillColorWithRainbow()
+void NeoPixelSegment::fillColorWithRainbow()
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::fillColorWithRainbow");
+	fillRainbowDirectly(0);
+	mColorMode = kManual;
+}
 
-	for(int i = 0; i < mLedCount; i++) {
-		setColorDirectly(i, Color(360, mLedHueUnit * i, 0xff, 0xff));
+void NeoPixelSegment::fillRainbowDirectly(int offset)
+{
+	if(mStrip.mPalette) {
+		// Fill the palette range with a rainbow and map led modules onto it
+		int paletteSize = paletteCount();
+		uint16_t hueStep = 0x10000 / paletteSize;
+		uint16_t hue = 0;
+		for(int i = 0; i < paletteSize; i++) {
+			mStrip.setPaletteColor(mPaletteFirst + i, Color::fromHsv(hue >> 8));
+			hue += hueStep;
+		}
+		for(int i = 0; i < mLedCount; i++) {
+			int position = (i + mLedCount - offset) % mLedCount;
+			setColorIndexDirectly(i, mPaletteFirst + position * paletteSize / mLedCount);
+		}
+	}
+	else {
+		uint16_t hueStep = 0x10000 / mLedCount;
+		uint16_t startHue = 0x10000 - offset * hueStep;	// hue 0 (red) at the offset
+		fillColorWithHueGradientDirectly(0, mLedCount, startHue, hueStep, 0xff, 0xff);
 	}
+}
+
+void NeoPixelSegment::fillColorWithHueGradient(int index, int count, uint16_t startHue, uint16_t hueStep, uint8_t s, uint8_t v)
+{
+	fillColorWithHueGradientDirectly(index, count, startHue, hueStep, s, v);
 	mColorMode = kManual;
 }
 
-void NeoPixel::setColor(int index, Color color)
+void NeoPixelSegment::fillColorWithHueGradientDirectly(int index, int count, uint16_t startHue, uint16_t hueStep, uint8_t s, uint8_t v)
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setColor");
+	EXT_KIT_ASSERT(0 <= index);
+	EXT_KIT_ASSERT(index + count <= mLedCount);
 
+	uint16_t hue = startHue;
+	if(mStrip.mPalette) {
+		for(int i = 0; i < count; i++) {
+			setColorIndexDirectly(index + i, paletteIndexForColor(Color::fromHsv(hue >> 8, s, v)));
+			hue += hueStep;
+		}
+		return;
+	}
+
+	uint8_t* p = &mStrip.mLedBuffer[(mFirst + index) * kBytesPerLed];
+	for(int i = 0; i < count; i++) {
+		Color color = Color::fromHsv(hue >> 8, s, v);
+		*p++ = color.g();
+		*p++ = color.r();
+		*p++ = color.b();
+		hue += hueStep;
+	}
+}
+
+void NeoPixelSegment::setColor(int index, Color color)
+{
 	setColorDirectly(index, color);
 	mColorMode = kManual;
 }
 
-void NeoPixel::setColorDirectly(int index, Color color)
+void NeoPixelSegment::setColorDirectly(int index, Color color)
 {
 	EXT_KIT_ASSERT(0 <= index);
 	EXT_KIT_ASSERT(index < mLedCount);
 
-	uint8_t* p = &mLedBuffer[index * kBytesPerLed];
+	if(mStrip.mPalette) {
+		setColorIndexDirectly(index, paletteIndexForColor(color));
+		return;
+	}
+
+	uint8_t* p = &mStrip.mLedBuffer[(mFirst + index) * kBytesPerLed];
 	*p++ = color.g();
 	*p++ = color.r();
 	*p++ = color.b();
 }
 
-Color NeoPixel::color(int index)
+Color NeoPixelSegment::color(int index)
 {
 	EXT_KIT_ASSERT(0 <= index);
 	EXT_KIT_ASSERT(index < mLedCount);
 
-	uint8_t* p = &mLedBuffer[index * kBytesPerLed];
+	if(mStrip.mPalette) {
+		return mStrip.paletteColor(mStrip.colorIndexAt(mFirst + index));
+	}
+
+	uint8_t* p = &mStrip.mLedBuffer[(mFirst + index) * kBytesPerLed];
 	uint8_t g = *p++;
 	uint8_t r = *p++;
 	uint8_t b = *p++;
 	return Color(r, g, b);
 }
 
-void NeoPixel::rotateLeft()
+void NeoPixelSegment::fillColorIndex(uint8_t paletteIndex)
+{
+	fillColorIndexDirectly(paletteIndex);
+	mColorMode = kManual;
+}
+
+void NeoPixelSegment::fillColorIndexDirectly(uint8_t paletteIndex)
+{
+	EXT_KIT_ASSERT(mStrip.mPalette);
+
+	for(int i = 0; i < mLedCount; i++) {
+		mStrip.setColorIndexAt(mFirst + i, paletteIndex);
+	}
+}
+
+void NeoPixelSegment::setColorIndex(int index, uint8_t paletteIndex)
+{
+	setColorIndexDirectly(index, paletteIndex);
+	mColorMode = kManual;
+}
+
+void NeoPixelSegment::setColorIndexDirectly(int index, uint8_t paletteIndex)
+{
+	EXT_KIT_ASSERT(0 <= index);
+	EXT_KIT_ASSERT(index < mLedCount);
+	EXT_KIT_ASSERT(mStrip.mPalette);
+
+	mStrip.setColorIndexAt(mFirst + index, paletteIndex);
+}
+
+uint8_t NeoPixelSegment::colorIndex(int index)
+{
+	EXT_KIT_ASSERT(0 <= index);
+	EXT_KIT_ASSERT(index < mLedCount);
+	EXT_KIT_ASSERT(mStrip.mPalette);
+
+	return mStrip.colorIndexAt(mFirst + index);
+}
+
+void NeoPixelSegment::fillColorMapEntryDirectly(int entry)
+{
+	if(mStrip.mPalette) {
+		fillColorIndexDirectly(mPaletteFirst + entry);
+	}
+	else {
+		fillColorDirectly(mColorMap[entry]);
+	}
+}
+
+void NeoPixelSegment::setColorMapEntryDirectly(int index, int entry)
+{
+	if(mStrip.mPalette) {
+		setColorIndexDirectly(index, mPaletteFirst + entry);
+	}
+	else {
+		setColorDirectly(index, mColorMap[entry]);
+	}
+}
+
+void NeoPixelSegment::rotateLeft()
 {
 	if(mLedCount <= 1) {
 		return;
 	}
 
-	uint8_t* src = &mLedBuffer[0];
-	uint8_t* dst = &mLedBuffer[0];
+	if(mStrip.mPalette) {
+		const uint8_t v = mStrip.colorIndexAt(mFirst);
+		for(int i = 1; i < mLedCount; i++) {
+			mStrip.setColorIndexAt(mFirst + i - 1, mStrip.colorIndexAt(mFirst + i));
+		}
+		mStrip.setColorIndexAt(mFirst + mLedCount - 1, v);
+		return;
+	}
+
+	uint8_t* src = &mStrip.mLedBuffer[mFirst * kBytesPerLed];
+	uint8_t* dst = src;
 	const uint8_t v1 = *src++;
 	const uint8_t v2 = *src++;
 	const uint8_t v3 = *src++;
@@ -215,14 +872,23 @@ void NeoPixel::rotateLeft()
 	*dst++ = v3;
 }
 
-void NeoPixel::rotateRight()
+void NeoPixelSegment::rotateRight()
 {
 	if(mLedCount <= 1) {
 		return;
 	}
 
-	uint8_t* src = &mLedBuffer[mLedBufferLength];
-	uint8_t* dst = &mLedBuffer[mLedBufferLength];
+	if(mStrip.mPalette) {
+		const uint8_t v = mStrip.colorIndexAt(mFirst + mLedCount - 1);
+		for(int i = mLedCount - 1; 0 < i; i--) {
+			mStrip.setColorIndexAt(mFirst + i, mStrip.colorIndexAt(mFirst + i - 1));
+		}
+		mStrip.setColorIndexAt(mFirst, v);
+		return;
+	}
+
+	uint8_t* src = &mStrip.mLedBuffer[(mFirst + mLedCount) * kBytesPerLed];
+	uint8_t* dst = src;
 	const uint8_t v1 = *(--src);
 	const uint8_t v2 = *(--src);
 	const uint8_t v3 = *(--src);
@@ -236,10 +902,8 @@ void NeoPixel::rotateRight()
 	*(--dst) = v3;
 }
 
-void NeoPixel::setColorMapForIndicator(Color colorOff, Color colorOn)
+void NeoPixelSegment::setColorMapForIndicator(Color colorOff, Color colorOn)
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setColorMapForIndicator");
-
 	mColorMap[0] = colorOff;
 	mColorMap[1] = colorOn;
 	mColorMap[2] = colorOn;
@@ -248,18 +912,14 @@ void NeoPixel::setColorMapForIndicator(Color colorOff, Color colorOn)
 	fillColorUsingColorMode();
 }
 
-void NeoPixel::fillColorWithIndicatorPattern(uint32_t indicatorPattern)
+void NeoPixelSegment::fillColorWithIndicatorPattern(uint32_t indicatorPattern)
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::fillColorWithIndicatorPattern: 0x", string::hex(indicatorPattern).toCharArray());
-
 	mIndicatorPattern = indicatorPattern;
 	fillColorUsingColorMode();
 }
 
-void NeoPixel::setColorMapForFocus(Color colorOff, Color colorOn1, Color colorOn2, Color colorOn3)
+void NeoPixelSegment::setColorMapForFocus(Color colorOff, Color colorOn1, Color colorOn2, Color colorOn3)
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setColorMapForFocus");
-
 	mColorMap[0] = colorOff;
 	mColorMap[1] = colorOn1;
 	mColorMap[2] = colorOn2;
@@ -268,153 +928,191 @@ void NeoPixel::setColorMapForFocus(Color colorOff, Color colorOn1, Color colorOn
 	fillColorUsingColorMode();
 }
 
-void NeoPixel::setRainbowMapForFocus()
+void NeoPixelSegment::setRainbowMapForFocus()
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::setRainbowMapForFocus");
-
 	mColorMode = kRainbowMapForFocus;
 	fillColorUsingColorMode();
 }
 
-void NeoPixel::fillColorWithFocusDirection(Direction focusDirection)
+void NeoPixelSegment::fillColorWithFocusDirection(Direction focusDirection)
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "NeoPixel::fillColorWithFocusDirection: 0x", string::hex(focusDirection).toCharArray());
-
 	mFocusDirection = focusDirection;
 	fillColorUsingColorMode();
 }
 
-void NeoPixel::fillColorUsingColorMode()
+void NeoPixelSegment::fillColorUsingColorMode()
 {
+	if(mStrip.mPalette && (mColorMode != kManual) && (mColorMode != kRainbowMapForFocus)) {
+		// load the color map into the first 2 or 4 colors of the palette range
+		int entryCount = (mColorMode == kColorMapForIndicator) ? 2 : 4;
+		EXT_KIT_ASSERT(entryCount <= paletteCount());
+
+		for(int i = 0; i < entryCount; i++) {
+			mStrip.setPaletteColor(mPaletteFirst + i, mColorMap[i]);
+		}
+	}
+
 	if(mColorMode == kColorMapForIndicator) {
 		uint32_t indicatorPattern = mIndicatorPattern;
-		if(0 < mLedCount) {
-			for(int i = mLedCount - 1; 0 <= i; i--) {
-				setColorDirectly(i, indicatorPattern & 1 ? mColorMap[1] : mColorMap[0]);
-				indicatorPattern >>= 1;
-			}
+		for(int i = mLedCount - 1; 0 <= i; i--) {
+			setColorMapEntryDirectly(i, indicatorPattern & 1);
+			indicatorPattern >>= 1;
 		}
 	}
 	else if((mColorMode == kColorMapForFocus) || (mColorMode == kRainbowMapForFocus)) {
-		int offset = -1;
+		int octant = -1;	// one of eight directions clockwise from north
 		switch(mFocusDirection) {
 			case direction::kN:		{
-				offset = 0;
+				octant = 0;
 				break;
 			}
 			case direction::kLF:
 			case direction::kNE:	{
-				offset = 3;
+				octant = 1;
 				break;
 			}
 			case direction::kE:		{
-				offset = 6;
+				octant = 2;
 				break;
 			}
 			case direction::kLB:
 			case direction::kSE:	{
-				offset = 9;
+				octant = 3;
 				break;
 			}
 			case direction::kS:		{
-				offset = 12;
+				octant = 4;
 				break;
 			}
 			case direction::kRB:
 			case direction::kSW:	{
-				offset = 15;
+				octant = 5;
 				break;
 			}
 			case direction::kW:		{
-				offset = 18;
+				octant = 6;
 				break;
 			}
 			case direction::kRF:
 			case direction::kNW:	{
-				offset = 21;
+				octant = 7;
 				break;
 			}
 		}
 		if(mColorMode == kColorMapForFocus) {
-			fillColorDirectly(mColorMap[0]);
-			if(0 < offset) {
-				setColorDirectly(offset - 1,	mColorMap[1]);
-				setColorDirectly(offset,		mColorMap[2]);
-				setColorDirectly(offset + 1,	mColorMap[3]);
-			}
-			else if(offset == 0) {
-				setColorDirectly(23,			mColorMap[1]);
-				setColorDirectly(0,				mColorMap[2]);
-				setColorDirectly(1,				mColorMap[3]);
+			fillColorMapEntryDirectly(0);
+			if(0 <= octant) {
+				int offset = mLedCount * octant / 8;	// e.g., 0, 3, 6, ... 21 for 24 led modules
+				setColorMapEntryDirectly((offset + mLedCount - 1) % mLedCount,	1);
+				setColorMapEntryDirectly(offset,								2);
+				setColorMapEntryDirectly((offset + 1) % mLedCount,				3);
 			}
 		}
 		else {	// (mColorMode == kRainbowMapForFocus)
-			if(0 <= offset) {
-				for(int i = 0; i < mLedCount; i++) {
-					setColorDirectly(i, Color(360, mLedHueUnit * (i + 24 - offset), 0xff, 0xff));
-				}
+			if(0 <= octant) {
+				fillRainbowDirectly(mLedCount * octant / 8);
 			}
 		}
 	}
 }
 
-void NeoPixel::debug_dumpPin(MicroBitPin* pin)
+/**	@struct	NeoPixel::SegmentRecord
+*/
+
+NeoPixel::SegmentRecord::SegmentRecord(NeoPixelSegment& segment)
+	: segment(segment)
 {
-	debug_sendMemoryDump(pin, sizeof(MicroBitPin) /* 16 */);
-	void** array = (void**) pin;
-	debug_sendMemoryDump(array[2], sizeof(DigitalOut) /* 24 */);
 }
 
-/*
-	An output example of NeoPixel::debug_dumpPin() for P1
+/**	@class	NeoPixelGroup
 */
 
-//	ec 21 00 20:  78 32 02 00  08 00 02 00  e8 29 00 20  0f 01 02 00
+NeoPixelGroup::~NeoPixelGroup()
+{
+	Node* p = &mRoot;
+	while((p = p->next) != &mRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
 
-#if 0
-#include "MicroBitComponent.h"
-	class MicroBitComponent {
-		void*			vtable;		// [0] 78 32 02 00
-		uint16_t		id;			// [4] 08 00 (MICROBIT_ID_IO_P1)
-		uint8_t			status;		// [6] 02    (IO_STATUS_DIGITAL_OUT)
-									// [7] 00    (padding)
-	};								// [8]
+		StripRecord* r = static_cast<StripRecord*>(p);
+		r->strip.mGroupCount--;
+	}
+}
 
-#include "TARGET_MCU_NRF51822/TARGET_NRF51_MICROBIT/PinNames.h"
-#include "MicroBitPin.h"
-	class MicroBitPin : public MicroBitComponent {
-		void*			pin;		// [8]  e8 29 00 20 (DigitalOut*)
-		PinCapability	capability;	// [12] 0f    (PIN_CAPABILITY_ALL)
-		uint8_t			pullMode;	// [13] 01     (PullDown)
-		PinName			name;		// [14] 02 00 (MICROBIT_PIN_P1=P0_2=p2)
-	};								// [16]
-#endif	// 0
+void NeoPixelGroup::addStrip(NeoPixel& strip)
+{
+	Node* p = new StripRecord(strip);
+	EXT_KIT_ASSERT_OR_PANIC(p, panic::kOutOfMemory);
 
-//	e8 29 00 20:  02 00 00 00  04 00 00 00  14 05 00 50  08 05 00 50
-//	f8 29 00 20:  0c 05 00 50  10 05 00 50
+	p->linkBefore(mRoot);
+	strip.mGroupCount++;
+}
 
-#if 0
-#include "TARGET_MCU_NRF51822/gpio_object.h"
-	typedef struct {
-		PinName			pin;		// [0]  02 00 (MICROBIT_PIN_P1=P0_2=p2)
-									// [2]  00 00 (padding)
-		uint32_t		mask;		// [4]  04 00 00 00 -> r1 in sendBuffer()
-		__IO uint32_t*	reg_dir;	// [8]  14 05 00 50
-		__IO uint32_t*	reg_set;	// [12] 08 05 00 50 -> r3 in sendBuffer()
-		__IO uint32_t*	reg_clr;	// [16] 0c 05 00 50 -> r2 in sendBuffer()
-		__I  uint32_t*	reg_in;		// [20] 10 05 00 50
-	} gpio_t;						// [24]
+void NeoPixelGroup::removeStrip(NeoPixel& strip)
+{
+	Node* p = &mRoot;
+	while((p = p->next) != &mRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		StripRecord* r = static_cast<StripRecord*>(p);
+		if(&(r->strip) == &strip) {
+			p = r->prev;	// rewind p
+			r->unlink();	// unlink and delete r
+			delete r;
+			strip.mGroupCount--;
+		}
+	}
+}
 
-#include "DigitalOut.h"
-	class DigitalOut {
-		gpio_t			gpio;		// [0]
-	};								// [24]
-#endif	// 0
+void NeoPixelGroup::show()
+{
+	// Prepare all output buffers before disabling IRQ
+	Node* p = &mRoot;
+	while((p = p->next) != &mRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		StripRecord* r = static_cast<StripRecord*>(p);
+		r->strip.prepareOutput();
+	}
+
+	// Send all output buffers back-to-back
+	__disable_irq();
+	p = &mRoot;
+	while((p = p->next) != &mRoot) {
+		StripRecord* r = static_cast<StripRecord*>(p);
+		r->strip.sendOutput();
+	}
+	__enable_irq();
+}
+
+/**	@struct	NeoPixelGroup::StripRecord
+*/
+
+NeoPixelGroup::StripRecord::StripRecord(NeoPixel& strip)
+	: strip(strip)
+{
+}
+
+int colorDistance(uint8_t a, uint8_t b)
+{
+	return (a < b) ? (b - a) : (a - b);
+}
+
+/*
+	Layout checks for the field offsets used by sendBuffer(). See the output example above.
+*/
+
+static_assert(sizeof(MicroBitComponent) == 8,		"sendBuffer() expects MicroBitPin::pin at [8]");
+static_assert(sizeof(DigitalOut) == 24,				"sendBuffer() expects DigitalOut to be gpio_t");
+static_assert(offsetof(gpio_t, mask) == 4,			"sendBuffer() expects gpio_t::mask at [4]");
+static_assert(offsetof(gpio_t, reg_set) == 12,		"sendBuffer() expects gpio_t::reg_set at [12]");
+static_assert(offsetof(gpio_t, reg_clr) == 16,		"sendBuffer() expects gpio_t::reg_clr at [16]");
 
 /**
 	@reference	Microsoft pxt-ws2812b sendBuffer.asm (MIT license)
 		- https://github.com/Microsoft/pxt-ws2812b
 		- https://github.com/Microsoft/pxt-ws2812b/blob/master/sendBuffer.asm
+	@note	The cycles of the paths below are summed up by ws2812::sendBufferModel in ExtKitWs2812.h, which also gives the number of nops in `.start`. Keep them in sync.
+	@note	IRQ is disabled and enabled by the caller, not inside this function, so that two or more strips can be sent within one IRQ-disabled window.
 */
 const uint8_t* sendBuffer(MicroBitPin* pin, const uint8_t* buf, int len)
 {
@@ -435,7 +1133,6 @@ const uint8_t* sendBuffer(MicroBitPin* pin, const uint8_t* buf, int len)
 		"ldr r2, [r0, #16]		\n\t"	// r2 := pin->pin->reg_clr
 		"ldr r3, [r0, #12]		\n\t"	// r3 := pin->pin->reg_set
 
-		"cpsid i				\n\t"	// disable irq
 		"b .start				\n\t"	// goto .start
 
 	".nextbit:					\n\t"	// [0] or [20]
@@ -455,7 +1152,9 @@ const uint8_t* sendBuffer(MicroBitPin* pin, const uint8_t* buf, int len)
 
 	".start:					\n\t"	// [11]
 		"movs r6, #0x80			\n\t"	// [12]			r6 (mask) := 0x80
-		"nop					\n\t"	// [13]
+		".rept %c[nops]			\n\t"	// [13]			ws2812::sendBufferModel::kByteBoundaryNopCount (1) nops
+		"nop					\n\t"
+		".endr					\n\t"
 
 	".common:					\n\t"	// [13]
 		"str r1, [r2, #0]		\n\t"	// [14][15]		pin := low	... high duration is 812.5 ns ([15] - [2] = 13 cycles)
@@ -471,8 +1170,6 @@ const uint8_t* sendBuffer(MicroBitPin* pin, const uint8_t* buf, int len)
 	".stop:						\n\t"	// [13]
 		"str r1, [r2, #0]		\n\t"	// [14][15]		pin := low	... high duration is 812.5 ns ([15] - [2] = 13 cycles)
 
-		"cpsie i				\n\t"	// enable irq
-
 		// *** END code from sendBuffer.asm ***
 
 		// write to output
@@ -482,7 +1179,7 @@ const uint8_t* sendBuffer(MicroBitPin* pin, const uint8_t* buf, int len)
 		: [ret] "=r" (ret)
 
 		// input_operand_list
-		: [pin] "r" (pin), [buf] "r" (buf), [len] "r" (len)
+		: [pin] "r" (pin), [buf] "r" (buf), [len] "r" (len), [nops] "i" (ws2812::sendBufferModel::kByteBoundaryNopCount)
 
 		// clobbered_register_list
 		: "r4", "r5", "r6", "cc", "memory"
@@ -15,8 +15,137 @@
 namespace microbit_dal_ext_kit {
 namespace radio {
 
+//																		 123456789abcdef012345
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRxDatagrams,	"\x15", "Radio Rx Datagrams:  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRxDepthMax,	"\x15", "Radio Rx Depth Max:  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRxQueueFull,	"\x15", "Radio Rx Queue Full: ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxWaitLow,		"\x15", "Radio Tx Wait L (ms):")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxWaitNormal,	"\x15", "Radio Tx Wait N (ms):")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxWaitHigh,		"\x15", "Radio Tx Wait H (ms):")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxDropsLow,		"\x15", "Radio Tx Drops L:    ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxDropsNormal,	"\x15", "Radio Tx Drops N:    ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxDropsHigh,		"\x15", "Radio Tx Drops H:    ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxWindow,		"\x15", "Radio Tx Window (ms):")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsTxBackoffs,		"\x15", "Radio Tx Backoffs:   ")
+
+/// Statistics Key Strings for the queue latency of each class
+static const ManagedString* const sStatisticsTxWait[kPriorityCount] = { &sStatisticsTxWaitLow, &sStatisticsTxWaitNormal, &sStatisticsTxWaitHigh };
+
+/// Statistics Key Strings for the drops of each class
+static const ManagedString* const sStatisticsTxDrops[kPriorityCount] = { &sStatisticsTxDropsLow, &sStatisticsTxDropsNormal, &sStatisticsTxDropsHigh };
+
+/// Transmit Queue Size
+static const int kTxQueueSize = 8;
+
+/// Event value with `MICROBIT_ID_NOTIFY` to wake up the drain fiber
+static const uint16_t kTxQueueNotifyValue = 0x4578;	// 'Ex'
+
+/// Interval in milliseconds to check the transmit queue in waitForTxQueue()
+static const uint32_t kTxQueueWaitInterval = 1;
+
+/// Transmit Queue Entry
+struct TxQueueEntry
+{
+	/// Datagram
+	uint8_t				datagram[MICROBIT_RADIO_MAX_PACKET_SIZE];
+
+	/// Datagram Length. 0 means the entry is free.
+	uint8_t				length;
+
+	/// Priority
+	uint8_t				priority;
+
+	/// Datagram is dropped after the deadline
+	bool				hasDeadline;
+
+	/// Order of the datagram queued
+	uint16_t			order;
+
+	/// Time when the datagram is queued
+	time::SystemTime	queuedTime;
+
+	/// Deadline
+	time::SystemTime	deadline;
+
+};	// TxQueueEntry
+
+/// Datagram Protocol Record
+struct DatagramProtocolRecord : public Node
+{
+	/// Constructor
+	DatagramProtocolRecord(DatagramProtocol& protocol)
+		: protocol(protocol)
+	{
+	}
+
+	/// Datagram Protocol
+	DatagramProtocol&	protocol;
+
+};	// DatagramProtocolRecord
+
+/// Root Node for DatagramProtocolRecord
+static RootForDynamicNodes	sRoot;
+
+/// Transport, which is 0 for `MicroBitRadio`
+static TransportProtocol*	sTransport = 0;
+
+/// Number of datagrams received
+static uint16_t	sDatagramCount = 0;
+
+/// Max Queue Depth found
+static uint16_t	sDepthMax = 0;
+
+/// RSSI of the datagram being handled
+static int		sRssi = 0;
+
+/// Transmit Queue
+static TxQueueEntry	sTxQueue[kTxQueueSize];
+
+/// Order of the next datagram queued
+static uint16_t	sTxOrder = 0;
+
+/// The drain fiber is created
+static bool		sTxDrainFiberCreated = false;
+
+/// Smoothed queue latency in 1/16 milliseconds for each class, which keeps the fraction of the smoothing
+static uint32_t	sTxWait[kPriorityCount];
+
+/// Number of drops for each class
+static uint16_t	sTxDrops[kPriorityCount];
+
+/// Contention Control of this device
+static ContentionControl	sContention;
+
+/// Number of backoffs
+static uint16_t	sBackoffCount = 0;
+
+static void handleRadioDatagramReceived(MicroBitEvent event);
+static void deliverDatagram(const uint8_t* datagram, int length);
+static void updateStatistics(uint16_t depth);
+static void drainTxQueue();
+static void dropTxQueueEntry(TxQueueEntry& e);
+static bool isTxQueueFull();
+
+void setTransport(TransportProtocol* transport)
+{
+	sTransport = transport;
+	if(sTransport) {
+		sTransport->prepareTransport();
+	}
+}
+
+TransportProtocol* transport()
+{
+	return sTransport;
+}
+
 void prepare()
 {
+	if(sTransport) {
+		sTransport->prepareTransport();
+		return;
+	}
+
 	static bool sPrepared = false;
 	if(sPrepared) {
 		return;
@@ -38,6 +167,11 @@ void send(const ManagedString& command)
 		return;
 	}
 
+	if(sTransport) {
+		sTransport->sendDatagram((const uint8_t*) command.toCharArray(), command.length());
+		return;
+	}
+
 	MicroBitRadio* r = ExtKit::global().radio();
 	if(!r) {
 		return;
@@ -49,6 +183,12 @@ void send(const ManagedString& command)
 
 ManagedString /*received */ recv()
 {
+	if(sTransport) {
+		uint8_t buffer[MICROBIT_RADIO_MAX_PACKET_SIZE];
+		int length = sTransport->recvDatagram(buffer, sizeof(buffer));
+		return ManagedString((const char*) buffer, length);
+	}
+
 	MicroBitRadio* r = ExtKit::global().radio();
 	if(!r) {
 		return ManagedString(ManagedString::EmptyString);
@@ -59,5 +199,374 @@ ManagedString /*received */ recv()
 	return received;
 }
 
+void send(const uint8_t* buffer, int length)
+{
+	if(length <= 0) {
+		return;
+	}
+
+	if(sTransport) {
+		sTransport->sendDatagram(buffer, length);
+		return;
+	}
+
+	MicroBitRadio* r = ExtKit::global().radio();
+	if(!r) {
+		return;
+	}
+
+	r->datagram.send(const_cast<uint8_t*>(buffer), length);
+}
+
+bool /* queued */ send(const uint8_t* buffer, int length, Priority priority, uint16_t lifetime)
+{
+	EXT_KIT_ASSERT((0 <= priority) && (priority < kPriorityCount));
+
+	if((length <= 0) || (MICROBIT_RADIO_MAX_PACKET_SIZE < length)) {
+		return false;
+	}
+
+	// Find a free entry, or the oldest entry in the lowest class as a victim
+	TxQueueEntry* found = 0;
+	for(int i = 0; i < kTxQueueSize; i++) {
+		TxQueueEntry& e = sTxQueue[i];
+		if(!e.length) {
+			found = &e;
+			break;
+		}
+		if(!found || (e.priority < found->priority) || ((e.priority == found->priority) && ((int16_t) (e.order - found->order) < 0))) {
+			found = &e;
+		}
+	}
+	if(found->length) {
+		if(priority < found->priority) {
+			Statistics::setItem(*sStatisticsTxDrops[priority], ++sTxDrops[priority]);
+			return false;	// the queue is full of higher priority datagrams
+		}
+		dropTxQueueEntry(*found);
+	}
+
+	memcpy(found->datagram, buffer, length);
+	found->length = length;
+	found->priority = priority;
+	found->hasDeadline = (lifetime != 0);
+	found->order = sTxOrder++;
+	found->queuedTime = time::systemTime();
+	found->deadline = found->queuedTime + lifetime;
+
+	// Wake up the drain fiber
+	if(!sTxDrainFiberCreated) {
+		sTxDrainFiberCreated = true;
+		create_fiber(drainTxQueue);
+	}
+	else {
+		MicroBitEvent(MICROBIT_ID_NOTIFY_ONE, kTxQueueNotifyValue);
+	}
+	return true;
+}
+
+void waitForTxQueue()
+{
+	while(isTxQueueFull() && fiber_scheduler_running()) {
+		time::sleep(kTxQueueWaitInterval);
+	}
+}
+
+void setContention(uint16_t windowMin, uint16_t windowMax, uint8_t slotCount, uint16_t slotLength)
+{
+	sContention.set(windowMin, windowMax, slotCount, slotLength);
+}
+
+bool isContentionEnabled()
+{
+	return sContention.windowMax != 0;
+}
+
+void reportLoss()
+{
+	if(sContention.widen()) {
+		Statistics::setItem(sStatisticsTxWindow, sContention.window);
+		Statistics::setItem(sStatisticsTxBackoffs, ++sBackoffCount);
+	}
+}
+
+void reportDelivery()
+{
+	if(sContention.narrow()) {
+		Statistics::setItem(sStatisticsTxWindow, sContention.window);
+	}
+}
+
+uint32_t /* milliseconds */ contentionDelay()
+{
+	return sContention.delay(microbit_serial_number(), time::networkTime());
+}
+
+/**	@class	ContentionControl
+*/
+
+ContentionControl::ContentionControl()
+	: windowMin(0)
+	, windowMax(0)
+	, window(0)
+	, slotCount(0)
+	, slotLength(0)
+{
+}
+
+void ContentionControl::set(uint16_t windowMin, uint16_t windowMax, uint8_t slotCount, uint16_t slotLength)
+{
+	this->windowMin = (windowMin < windowMax) ? windowMin : windowMax;
+	this->windowMax = windowMax;
+	this->window = this->windowMin;
+	this->slotCount = slotLength ? slotCount : 0;
+	this->slotLength = slotLength;
+}
+
+bool ContentionControl::widen()
+{
+	if(!windowMax || (windowMax <= window)) {
+		return false;
+	}
+
+	uint32_t widened = window ? window * 2 : 1;
+	window = (widened < windowMax) ? widened : windowMax;
+	return true;
+}
+
+bool ContentionControl::narrow()
+{
+	if(!windowMax || (window <= windowMin)) {
+		return false;
+	}
+
+	window /= 2;
+	if(window < windowMin) {
+		window = windowMin;
+	}
+	return true;
+}
+
+uint32_t /* milliseconds */ ContentionControl::delay(uint32_t serialNumber, uint32_t now) const
+{
+	if(!windowMax) {
+		return 0;
+	}
+
+	if(!slotCount) {
+		return microbit_random(window + 1);
+	}
+
+	// Defer to the slot of the node
+	uint32_t frameLength = (uint32_t) slotCount * slotLength;
+	uint32_t slotStart = (serialNumber % slotCount) * slotLength;
+	uint32_t position = now % frameLength;
+	uint32_t delay = (slotStart + frameLength - position) % frameLength;
+	uint16_t jitterMax = slotLength / 2;
+	return delay + microbit_random(((window < jitterMax) ? window : jitterMax) + 1);
+}
+
+int /* length */ recv(uint8_t* /* OUT */ buffer, int bufferSize)
+{
+	if(sTransport) {
+		return sTransport->recvDatagram(buffer, bufferSize);
+	}
+
+	MicroBitRadio* r = ExtKit::global().radio();
+	if(!r) {
+		return 0;
+	}
+
+	int length = r->datagram.recv(buffer, bufferSize);	// returns the length received, or MICROBIT_INVALID_PARAMETER.
+	return (0 < length) ? length : 0;
+}
+
+void listen(DatagramProtocol& protocol)
+{
+	if(sRoot.next == &sRoot) {
+		MicroBitMessageBus& mb = ExtKit::global().messageBus();
+		mb.listen(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, handleRadioDatagramReceived);
+	}
+
+	Node* p = new DatagramProtocolRecord(protocol);
+	EXT_KIT_ASSERT_OR_PANIC(p, panic::kOutOfMemory);
+
+	p->linkBefore(sRoot);
+}
+
+void ignore(DatagramProtocol& protocol)
+{
+	Node* p = &sRoot;
+	while((p = p->next) != &sRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		DatagramProtocolRecord* r = static_cast<DatagramProtocolRecord*>(p);
+		if(&(r->protocol) == &protocol) {
+			p = r->prev;	// rewind p
+			r->unlink();	// unlink and delete r
+			delete r;
+		}
+	}
+
+	if(sRoot.next == &sRoot) {
+		MicroBitMessageBus& mb = ExtKit::global().messageBus();
+		mb.ignore(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, handleRadioDatagramReceived);
+	}
+}
+
+int lastRssi()
+{
+	return sRssi;
+}
+
+void notifyTransportDatagrams()
+{
+	if(!sTransport) {
+		return;
+	}
+
+	// Drain every queued datagram
+	uint16_t depth = 0;
+	while(true) {
+		uint8_t datagram[MICROBIT_RADIO_MAX_PACKET_SIZE];
+		int length = sTransport->recvDatagram(datagram, sizeof(datagram));
+		if(length <= 0) {
+			break;
+		}
+		depth++;
+
+		sRssi = 0;	// unknown for the transport
+		deliverDatagram(datagram, length);
+	}
+
+	updateStatistics(depth);
+}
+
+void handleRadioDatagramReceived(MicroBitEvent /* event */)
+{
+	if(sTransport) {
+		return;	// datagrams are delivered by notifyTransportDatagrams()
+	}
+
+	MicroBitRadio* r = ExtKit::global().radio();
+	if(!r) {
+		return;
+	}
+
+	// Drain every queued datagram. The events for the datagrams drained here find the queue empty.
+	uint16_t depth = 0;
+	while(true) {
+		PacketBuffer packet = r->datagram.recv();	// returns an empty PacketBuffer if no data is available.
+		int length = packet.length();
+		if(length <= 0) {
+			break;
+		}
+		depth++;
+
+		sRssi = packet.getRSSI();
+		deliverDatagram(packet.getBytes(), length);
+	}
+
+	updateStatistics(depth);
+	if(MICROBIT_RADIO_MAXIMUM_RX_BUFFERS <= depth) {
+		Statistics::incrementItem(sStatisticsRxQueueFull);	// the following datagrams may be dropped by the DAL
+	}
+}
+
+void drainTxQueue()
+{
+	while(true) {
+		// Find the oldest entry in the highest class, dropping the stale ones
+		TxQueueEntry* found = 0;
+		for(int i = 0; i < kTxQueueSize; i++) {
+			TxQueueEntry& e = sTxQueue[i];
+			if(!e.length) {
+				continue;
+			}
+			if(e.hasDeadline && time::isElapsed(e.deadline)) {
+				dropTxQueueEntry(e);
+				continue;
+			}
+			if(!found || (found->priority < e.priority) || ((e.priority == found->priority) && ((int16_t) (e.order - found->order) < 0))) {
+				found = &e;
+			}
+		}
+		if(!found) {
+			fiber_wait_for_event(MICROBIT_ID_NOTIFY, kTxQueueNotifyValue);
+			continue;
+		}
+
+		// Update the smoothed queue latency
+		uint8_t priority = found->priority;
+		time::SystemTime wait = time::systemTime() - found->queuedTime;
+		if(UINT16_MAX < wait) {
+			wait = UINT16_MAX;
+		}
+		int32_t smoothed = sTxWait[priority];
+		smoothed += (((int32_t) wait << 4) - smoothed) / 8;
+		sTxWait[priority] = smoothed;
+		Statistics::setItem(*sStatisticsTxWait[priority], sTxWait[priority] >> 4);
+
+		uint8_t datagram[MICROBIT_RADIO_MAX_PACKET_SIZE];
+		int length = found->length;
+		bool hasDeadline = found->hasDeadline;
+		time::SystemTime deadline = found->deadline;
+		memcpy(datagram, found->datagram, length);
+		found->length = 0;
+
+		// Avoid the collision with the other nodes
+		uint32_t delay = contentionDelay();
+		if(delay) {
+			time::sleep(delay);
+			if(hasDeadline && time::isElapsed(deadline)) {
+				Statistics::setItem(*sStatisticsTxDrops[priority], ++sTxDrops[priority]);
+				continue;	// stale while deferred
+			}
+		}
+		send(datagram, length);
+	}
+}
+
+void dropTxQueueEntry(TxQueueEntry& e)
+{
+	Statistics::setItem(*sStatisticsTxDrops[e.priority], ++sTxDrops[e.priority]);
+	e.length = 0;
+}
+
+bool isTxQueueFull()
+{
+	for(int i = 0; i < kTxQueueSize; i++) {
+		if(!sTxQueue[i].length) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void deliverDatagram(const uint8_t* datagram, int length)
+{
+	Node* p = &sRoot;
+	while((p = p->next) != &sRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		DatagramProtocolRecord* record = static_cast<DatagramProtocolRecord*>(p);
+		record->protocol.handleRadioDatagram(datagram, length);
+	}
+}
+
+void updateStatistics(uint16_t depth)
+{
+	if(depth == 0) {
+		return;
+	}
+
+	sDatagramCount += depth;
+	Statistics::setItem(sStatisticsRxDatagrams, sDatagramCount);
+	if(sDepthMax < depth) {
+		sDepthMax = depth;
+		Statistics::setItem(sStatisticsRxDepthMax, sDepthMax);
+	}
+}
+
 }	// radio
 }	// microbit_dal_ext_kit
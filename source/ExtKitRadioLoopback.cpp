@@ -0,0 +1,284 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Radio Loopback component
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#include "ExtKitRadioLoopback.h"	// self
+#include "ExtKit.h"
+
+namespace microbit_dal_ext_kit {
+namespace radio {
+
+/**	@class	LoopbackTransport
+*/
+
+//																		 123456789abcdef012345
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsSent,		"\x15", "Loopback Sent:       ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsLost,		"\x15", "Loopback Lost:       ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsReordered,	"\x15", "Loopback Reordered:  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsOverflow,	"\x15", "Loopback Overflow:   ")
+
+/// Extra delay in milliseconds for a reordered datagram
+static const time::SystemTime kReorderDelay = 40;
+
+LoopbackTransport* LoopbackTransport::sGlobal = 0;
+
+LoopbackTransport& LoopbackTransport::global()
+{
+	EXT_KIT_ASSERT(sGlobal);
+
+	return *sGlobal;
+}
+
+LoopbackTransport::LoopbackTransport()
+	: Component("LoopbackTransport")
+	, mLossRate(0)
+	, mLatency(0)
+	, mJitter(0)
+	, mReorderRate(0)
+	, mSentCount(0)
+	, mLostCount(0)
+	, mReorderedCount(0)
+	, mOverflowCount(0)
+{
+	memset(mQueue, 0, sizeof(mQueue));
+
+	EXT_KIT_ASSERT(!sGlobal);
+
+	sGlobal = this;
+}
+
+LoopbackTransport::~LoopbackTransport()
+{
+	if(sGlobal == this) {
+		sGlobal = 0;
+	}
+}
+
+/* Component */ void LoopbackTransport::doHandleComponentAction(Action action)
+{
+	if(action == kStart) {
+		// Replace MicroBitRadio
+		radio::setTransport(this);
+
+		// Listen Periodic Observer for the delivery
+		PeriodicObserver::listen(PeriodicObserver::kUnit20ms, *this, PeriodicObserver::kPriorityHigh);
+	}
+	else if(action == kStop) {
+		// Ignore Periodic Observer
+		PeriodicObserver::ignore(PeriodicObserver::kUnit20ms, *this);
+
+		// Restore MicroBitRadio
+		if(radio::transport() == this) {
+			radio::setTransport(0);
+		}
+
+		// Discard the datagrams in flight
+		for(int i = 0; i < kQueueSize; i++) {
+			mQueue[i].length = 0;
+		}
+	}
+
+	Component::doHandleComponentAction(action);
+}
+
+void LoopbackTransport::setLossRate(uint16_t perMille)
+{
+	mLossRate = (perMille < 1000) ? perMille : 1000;
+}
+
+uint16_t LoopbackTransport::lossRate()
+{
+	return mLossRate;
+}
+
+void LoopbackTransport::setLatency(uint16_t latency, uint16_t jitter)
+{
+	mLatency = latency;
+	mJitter = jitter;
+}
+
+void LoopbackTransport::setReorderRate(uint16_t perMille)
+{
+	mReorderRate = (perMille < 1000) ? perMille : 1000;
+}
+
+uint16_t LoopbackTransport::sentCount()
+{
+	return mSentCount;
+}
+
+uint16_t LoopbackTransport::lostCount()
+{
+	return mLostCount;
+}
+
+/* TransportProtocol */ void LoopbackTransport::prepareTransport()
+{
+	// nothing to do
+}
+
+/* TransportProtocol */ void LoopbackTransport::sendDatagram(const uint8_t* datagram, int length)
+{
+	if((length <= 0) || (MICROBIT_RADIO_MAX_PACKET_SIZE < length)) {
+		return;
+	}
+
+	Statistics::setItem(sStatisticsSent, ++mSentCount);
+
+	if(mLossRate && ((uint32_t) microbit_random(1000) < mLossRate)) {
+		Statistics::setItem(sStatisticsLost, ++mLostCount);
+		return;
+	}
+
+	time::SystemTime delay = mLatency;
+	if(mJitter) {
+		delay += microbit_random(mJitter + 1);
+	}
+	if(mReorderRate && ((uint32_t) microbit_random(1000) < mReorderRate)) {
+		delay += kReorderDelay;
+		Statistics::setItem(sStatisticsReordered, ++mReorderedCount);
+	}
+
+	for(int i = 0; i < kQueueSize; i++) {
+		QueueEntry& e = mQueue[i];
+		if(e.length) {
+			continue;
+		}
+
+		memcpy(e.datagram, datagram, length);
+		e.length = length;
+		e.dueTime = time::systemTime() + delay;
+		return;
+	}
+
+	// The queue is full
+	Statistics::setItem(sStatisticsOverflow, ++mOverflowCount);
+}
+
+/* TransportProtocol */ int /* length */ LoopbackTransport::recvDatagram(uint8_t* /* OUT */ buffer, int bufferSize)
+{
+	// Find the earliest datagram due
+	QueueEntry* found = 0;
+	for(int i = 0; i < kQueueSize; i++) {
+		QueueEntry& e = mQueue[i];
+		if(!e.length || !time::isElapsed(e.dueTime)) {
+			continue;
+		}
+		if(!found || ((int32_t) (e.dueTime - found->dueTime) < 0)) {
+			found = &e;
+		}
+	}
+	if(!found) {
+		return 0;
+	}
+
+	int length = (found->length < bufferSize) ? found->length : bufferSize;
+	memcpy(buffer, found->datagram, length);
+	found->length = 0;
+	return length;
+}
+
+/* PeriodicObserver::HandlerProtocol */ void LoopbackTransport::handlePeriodicEvent(uint32_t /* count */, PeriodicObserver::PeriodUnit /* unit */)
+{
+	radio::notifyTransportDatagrams();
+}
+
+/*
+	Contention Benchmark
+*/
+
+/// Contention Mode for the benchmark
+enum ContentionMode {
+	kContentionNone,
+	kContentionJitter,
+	kContentionSlotted
+};
+
+/// Max Number of Nodes for the benchmark
+static const int kBenchmarkNodeCountMax = 16;
+
+/// Min Jitter Window in milliseconds for the benchmark
+static const uint16_t kBenchmarkWindowMin = 2;
+
+/// Max Jitter Window in milliseconds for the benchmark
+static const uint16_t kBenchmarkWindowMax = 32;
+
+/// Slot Length in milliseconds for the benchmark
+static const uint16_t kBenchmarkSlotLength = 2;
+
+/// Airtime in microseconds of a datagram at 1 Mbps, including the preamble, the address and the CRC
+static const uint32_t kBenchmarkAirTime = (MICROBIT_RADIO_MAX_PACKET_SIZE + 12) * 8;
+
+/// Simulate the rounds and return the delivery ratio in per mille
+static int /* per mille */ simulateContention(ContentionMode mode, int nodeCount, int slotCount, int roundCount)
+{
+	// Each simulated node has its own contention control and a random serial number, from which its slot is derived
+	ContentionControl contention[kBenchmarkNodeCountMax];
+	uint32_t serialNumber[kBenchmarkNodeCountMax];
+	uint32_t startTime[kBenchmarkNodeCountMax];
+	for(int i = 0; i < nodeCount; i++) {
+		if(mode == kContentionJitter) {
+			contention[i].set(kBenchmarkWindowMin, kBenchmarkWindowMax, 0, 0);
+		}
+		else if(mode == kContentionSlotted) {
+			contention[i].set(kBenchmarkWindowMin, kBenchmarkWindowMax, slotCount, kBenchmarkSlotLength);
+		}
+		serialNumber[i] = microbit_random(INT32_MAX);
+	}
+
+	int deliveredCount = 0;
+	for(int round = 0; round < roundCount; round++) {
+		// Every node sends on the same boundary, which is the beginning of the frame
+		for(int i = 0; i < nodeCount; i++) {
+			startTime[i] = contention[i].delay(serialNumber[i], /* network time */ 0) * 1000;
+		}
+
+		// A datagram is lost if another transmission overlaps it
+		for(int i = 0; i < nodeCount; i++) {
+			bool collided = false;
+			for(int j = 0; j < nodeCount; j++) {
+				uint32_t distance = (startTime[i] < startTime[j]) ? startTime[j] - startTime[i] : startTime[i] - startTime[j];
+				if((j != i) && (distance < kBenchmarkAirTime)) {
+					collided = true;
+					break;
+				}
+			}
+			if(collided) {
+				contention[i].widen();
+			}
+			else {
+				contention[i].narrow();
+				deliveredCount++;
+			}
+		}
+	}
+	return deliveredCount * 1000 / (nodeCount * roundCount);
+}
+
+void debug_sendContentionBenchmark(int nodeCountMax, int roundCount)
+{
+	EXT_KIT_ASSERT((0 < nodeCountMax) && (0 < roundCount));
+
+	if(kBenchmarkNodeCountMax < nodeCountMax) {
+		nodeCountMax = kBenchmarkNodeCountMax;
+	}
+
+	debug_sendLine(EXT_KIT_DEBUG_INFO "radio contention benchmark: rounds = ", ManagedString(roundCount).toCharArray());
+	debug_sendLine(EXT_KIT_DEBUG_INFO "- delivery [permil]: none / jitter / slotted");
+	for(int nodeCount = 1; nodeCount <= nodeCountMax; nodeCount++) {
+		ManagedString ratios = ManagedString(simulateContention(kContentionNone, nodeCount, nodeCountMax, roundCount))
+			+ " / " + ManagedString(simulateContention(kContentionJitter, nodeCount, nodeCountMax, roundCount))
+			+ " / " + ManagedString(simulateContention(kContentionSlotted, nodeCount, nodeCountMax, roundCount));
+		debug_sendLine(EXT_KIT_DEBUG_INFO "- nodes ", ManagedString(nodeCount).toCharArray(), ": ", ratios.toCharArray());
+	}
+}
+
+}	// radio
+}	// microbit_dal_ext_kit
@@ -15,177 +15,257 @@
 namespace microbit_dal_ext_kit {
 namespace remoteState {
 
-/**	@class	Transmitter
-*/
+/// Default Wire Format
+static const WireFormat kWireFormatDefault = EXT_KIT_CONFIG_ENABLED(REMOTE_STATE_BINARY) ? kWireFormatBinary : kWireFormatText;
 
-Transmitter* Transmitter::sGlobal = 0;
+/// Marker characters for the binary frame kinds
+static const char kMarkerForFrameKind[] = { 0, kMarkerRequest, kMarkerResponse, kMarkerNotification };
 
-Transmitter& Transmitter::global()
+int /* frameLength */ encodeFrame(uint8_t* /* OUT */ frame, const FrameHeader& header, int payloadLength)
 {
-	EXT_KIT_ASSERT(sGlobal);
+	EXT_KIT_ASSERT(0 <= payloadLength);
+	EXT_KIT_ASSERT(payloadLength <= kFrameSizeMax - kFrameHeaderSize);
 
-	return *sGlobal;
+	frame[0] = header.category;
+	frame[1] = header.flags | kFrameFlagBinary;
+	frame[2] = header.sequence;
+	return kFrameHeaderSize + payloadLength;
 }
 
-Transmitter::Transmitter()
-	: Component("Transmitter")
+int /* payloadLength */ decodeFrame(const uint8_t* frame, int frameLength, FrameHeader& /* OUT */ header)
 {
-	MicroBitRadio* r = ExtKit::global().radio();
-	EXT_KIT_ASSERT(r);
+	if((frameLength < kFrameHeaderSize) || (kFrameSizeMax < frameLength)) {
+		return -1;	// invalid length
+	}
 
-	EXT_KIT_ASSERT(!sGlobal);
+	uint8_t flags = frame[1];
+	if(!(flags & kFrameFlagBinary) || !(flags & kFrameKindMask)) {
+		return -1;	// not a binary frame
+	}
 
-	sGlobal = this;
+	header.category = frame[0];
+	header.flags = flags;
+	header.sequence = frame[2];
+	return frameLength - kFrameHeaderSize;
 }
 
-Transmitter::~Transmitter()
+int /* deltaLength */ encodeDelta(const uint8_t* last, const uint8_t* current, int length, uint8_t* /* OUT */ delta)
 {
-	if(sGlobal == this) {
-		sGlobal = 0;
+	int maskLength = (length + 7) / 8;
+	if(length <= maskLength) {
+		return -1;	// the delta never be shorter
+	}
+
+	memset(delta, 0, maskLength);
+	int deltaLength = maskLength;
+	for(int i = 0; i < length; i++) {
+		if(last[i] != current[i]) {
+			if(length <= deltaLength + 1) {
+				return -1;	// the delta is not shorter
+			}
+			delta[i >> 3] |= 1 << (i & 7);
+			delta[deltaLength++] = current[i];
+		}
 	}
+	return deltaLength;
 }
 
-/* Component */ void Transmitter::doHandleComponentAction(Action action)
+bool /* applied */ applyDelta(uint8_t* /* IN OUT */ state, int length, const uint8_t* delta, int deltaLength)
 {
-	if(action == kStart) {
-		radio::prepare();
+	int maskLength = (length + 7) / 8;
+	if(deltaLength < maskLength) {
+		return false;	// too short for the mask
+	}
 
-		// Listen to radio datagrams from the receiver
-		MicroBitMessageBus& mb = ExtKit::global().messageBus();
-		mb.listen(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, this, &Transmitter::handleRadioDatagramReceived);
+	// Validate the delta before changing the state
+	int changedCount = 0;
+	for(int i = 0; i < length; i++) {
+		if(delta[i >> 3] & (1 << (i & 7))) {
+			changedCount++;
+		}
 	}
-	else if(action == kStop) {
-		// Ignore radio datagrams from the receiver
-		MicroBitMessageBus& mb = ExtKit::global().messageBus();
-		mb.ignore(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, this, &Transmitter::handleRadioDatagramReceived);
+	if(maskLength + changedCount != deltaLength) {
+		return false;	// the length is not matched
 	}
 
-	Component::doHandleComponentAction(action);
+	const uint8_t* changed = &delta[maskLength];
+	for(int i = 0; i < length; i++) {
+		if(delta[i >> 3] & (1 << (i & 7))) {
+			state[i] = *changed++;
+		}
+	}
+	return true;
 }
 
-void Transmitter::listen(char category, CategoryProtocol& protocol)
+/// Hop Limit for the binary frames sent
+static uint8_t sRelayHopLimit = 0;
+
+int /* envelopeLength */ encodeRelayEnvelope(uint8_t* /* OUT */ envelope, const RelayHeader& header, const uint8_t* frame, int frameLength)
 {
-	Node* p = new CategoryRecord(category, protocol);
-	EXT_KIT_ASSERT_OR_PANIC(p, panic::kOutOfMemory);
+	if(kFrameSizeMax < kRelayHeaderSize + frameLength) {
+		return -1;	// too long for an envelope
+	}
 
-	p->linkBefore(mRoot);
+	envelope[0] = 0;
+	envelope[1] = kFrameFlagBinary | kFrameFlagBatch | kFrameKindRelay;
+	envelope[2] = (header.hops << 4) | (header.ttl & 0x0f);
+	envelope[3] = header.origin & 0xff;
+	envelope[4] = header.origin >> 8;
+	envelope[5] = header.age & 0xff;
+	envelope[6] = header.age >> 8;
+	memcpy(&envelope[kRelayHeaderSize], frame, frameLength);
+	return kRelayHeaderSize + frameLength;
 }
 
-void Transmitter::ignore(char category)
+int /* frameLength */ decodeRelayEnvelope(const uint8_t* envelope, int envelopeLength, RelayHeader& /* OUT */ header)
 {
-	Node* p = &mRoot;
-	while((p = p->next) != &mRoot) {
-		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+	if((envelopeLength <= kRelayHeaderSize + 1) || (kFrameSizeMax < envelopeLength)) {
+		return -1;	// invalid length
+	}
 
-		CategoryRecord* r = static_cast<CategoryRecord*>(p);
-		if(r->category == category) {
-			p = r->prev;	// rewind p
-			r->unlink();	// unlink and delete r
-			delete r;
-		}
+	if((envelope[0] != 0) || (envelope[1] != (kFrameFlagBinary | kFrameFlagBatch | kFrameKindRelay))) {
+		return -1;	// not a relay envelope
 	}
+
+	header.hops = envelope[2] >> 4;
+	header.ttl = envelope[2] & 0x0f;
+	header.origin = envelope[3] | (envelope[4] << 8);
+	header.age = envelope[5] | (envelope[6] << 8);
+	return envelopeLength - kRelayHeaderSize;
 }
 
-void Transmitter::requestToSend(char category)
+uint8_t relayCheckSum(const uint8_t* frame, int frameLength)
 {
-	Node* p = &mRoot;
-	while((p = p->next) != &mRoot) {
-		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
-
-		CategoryRecord* r = static_cast<CategoryRecord*>(p);
-		if(r->category == category) {
-			r->requestToSend(/* asResponse*/ false);
-			break;
-		}
+	uint8_t checkSum = 0;
+	for(int i = 1; i < frameLength; i++) {
+		checkSum = (checkSum << 1 | checkSum >> 7) ^ frame[i];
 	}
+	return checkSum;
 }
 
-void Transmitter::handleRadioDatagramReceived(MicroBitEvent /* event */)
+void setRelayHopLimit(uint8_t hopLimit)
 {
-	ManagedString received = radio::recv();
-	if(received.length() <= 1) {
-		return;
-	}
+	sRelayHopLimit = (hopLimit < kRelayTtlMax) ? hopLimit : kRelayTtlMax;
+}
 
-	char category = received.charAt(0);
-	Node* p = &mRoot;
-	while((p = p->next) != &mRoot) {
-		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+int relayHeaderSize()
+{
+	return sRelayHopLimit ? kRelayHeaderSize : 0;
+}
 
-		CategoryRecord* r = static_cast<CategoryRecord*>(p);
-		if(r->category == category) {
-			r->handleRadioCommandReceived(received);
-			break;
-		}
+/// Send a datagram, through the transmit queue if the contention control is enabled
+static void transmit(const uint8_t* datagram, int length)
+{
+	if(radio::isContentionEnabled()) {
+		radio::send(datagram, length, radio::kPriorityNormal);
+	}
+	else {
+		radio::send(datagram, length);
 	}
 }
 
-/**	@class	Transmitter::CategoryBase
-*/
-
-Transmitter::CategoryBase::CategoryBase(char category)
-	: mTransmitter(remoteState::Transmitter::global())
-	, mCategory(category)
+void sendFrame(const uint8_t* frame, int frameLength)
 {
-	mTransmitter.listen(mCategory, *this);
+	if(sRelayHopLimit && (1 < frameLength) && (frame[1] & kFrameFlagBinary)) {
+		RelayHeader header;
+		header.hops = 0;
+		header.ttl = sRelayHopLimit;
+		header.origin = (uint16_t) microbit_serial_number();
+		header.age = 0;
+
+		uint8_t envelope[kFrameSizeMax];
+		int envelopeLength = encodeRelayEnvelope(envelope, header, frame, frameLength);
+		if(0 < envelopeLength) {
+			transmit(envelope, envelopeLength);
+			return;
+		}
+	}
+
+	transmit(frame, frameLength);	// send without an envelope
 }
 
-/**	@class	Transmitter::CategoryRecord
+/**	@class	CategoryTable
 */
 
-Transmitter::CategoryRecord::CategoryRecord(char category, Transmitter::CategoryProtocol& protocol)
-	: protocol(protocol)
-	, category(category)
-	, mSequence(0)
+CategoryTable::CategoryTable()
+	: mTable(0)
+	, mBase(0)
+	, mSize(0)
 {
 }
 
-void Transmitter::CategoryRecord::requestToSend(bool asResponse)
+CategoryTable::~CategoryTable()
 {
-	ManagedString s = protocol.remoteState();
-	send(s, asResponse);
+	delete[] mTable;
 }
 
-void Transmitter::CategoryRecord::send(const ManagedString& remoteState, bool asResponse)
+void CategoryTable::set(char category, Node* node)
 {
-	ManagedString s(category);
-	char sequenceMarker;
-	if(asResponse) {
-		sequenceMarker = kMarkerResponse;
+	uint8_t c = category;
+	unsigned int i = c - (unsigned int) mBase;
+	if(i < mSize) {
+		mTable[i] = node;
+		return;
 	}
-	else {
-		sequenceMarker = kMarkerNotification;
-		mSequence++;
+
+	if(!node) {
+		return;	// not in the table
 	}
-	s =	s + string::hex(mSequence, sequenceMarker);
-	s = s + remoteState;
-	radio::send(s);
-}
 
-void Transmitter::CategoryRecord::handleRadioCommandReceived(ManagedString& received)
-{
-	char marker = received.charAt(1);
-	if(marker != kMarkerRequest) {
-		return;
+	// Extend the range
+	uint8_t base = c;
+	int top = c;
+	if(mSize) {
+		base = (mBase < c) ? mBase : c;
+		top = (mBase + mSize - 1 > c) ? mBase + mSize - 1 : c;
+	}
+	uint16_t size = top - base + 1;
+	Node** table = new Node*[size];
+	EXT_KIT_ASSERT_OR_PANIC(table, panic::kOutOfMemory);
+
+	memset(table, 0, size * sizeof(Node*));
+	if(mSize) {
+		memcpy(&table[mBase - base], mTable, mSize * sizeof(Node*));
 	}
+	table[c - base] = node;
 
-	requestToSend(/* asResponse*/ true);
+	delete[] mTable;
+	mTable = table;
+	mBase = base;
+	mSize = size;
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "CategoryTable: base, size: ", ManagedString((int) mBase).toCharArray(), ", ", ManagedString((int) mSize).toCharArray());
 }
 
-/**	@class	Receiver
+/**	@class	Transmitter
 */
 
-Receiver* Receiver::sGlobal = 0;
+//																		 123456789abcdef012345
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsBatchFrames,		"\x15", "Tx Batch Frames:     ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsBatchDatagrams,	"\x15", "Tx Batch Datagrams:  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsBatchFill,		"\x15", "Tx Batch Fill (%):   ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsUnsubscribed,	"\x15", "Tx Unsubscribed:     ")
 
-Receiver& Receiver::global()
+Transmitter* Transmitter::sGlobal = 0;
+
+Transmitter& Transmitter::global()
 {
 	EXT_KIT_ASSERT(sGlobal);
 
 	return *sGlobal;
 }
 
-Receiver::Receiver()
-	: Component("Receiver")
+Transmitter::Transmitter()
+	: Component("Transmitter")
+	, mWireFormat(kWireFormatDefault)
+	, mBatchEnabled(false)
+	, mBatchPending(false)
+	, mBatchFrameCount(0)
+	, mBatchDatagramCount(0)
+	, mBatchByteCount(0)
+	, mReliableCount(0)
+	, mRateLimitedCount(0)
+	, mSubscriptionRequired(false)
+	, mUnsubscribedCount(0)
 {
 	MicroBitRadio* r = ExtKit::global().radio();
 	EXT_KIT_ASSERT(r);
@@ -195,46 +275,47 @@ Receiver::Receiver()
 	sGlobal = this;
 }
 
-Receiver::~Receiver()
+Transmitter::~Transmitter()
 {
 	if(sGlobal == this) {
 		sGlobal = 0;
 	}
 }
 
-/* Component */ void Receiver::doHandleComponentAction(Action action)
+/* Component */ void Transmitter::doHandleComponentAction(Action action)
 {
 	if(action == kStart) {
 		radio::prepare();
 
-		// Listen to radio datagrams from the transmitter
-		MicroBitMessageBus& mb = ExtKit::global().messageBus();
-		mb.listen(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, this, &Receiver::handleRadioDatagramReceived);
+		// Listen to radio datagrams from the receiver
+		radio::listen(*this);
 
-		// Listen Periodic Observer
-		PeriodicObserver::listen(PeriodicObserver::kUnit100ms, *this, PeriodicObserver::kPriorityLow);
+		// Listen Periodic Observer for batching
+		PeriodicObserver::listen(PeriodicObserver::kUnit20ms, *this, PeriodicObserver::kPriorityLow);
 	}
 	else if(action == kStop) {
 		// Ignore Periodic Observer
-		PeriodicObserver::ignore(PeriodicObserver::kUnit100ms, *this);
+		PeriodicObserver::ignore(PeriodicObserver::kUnit20ms, *this);
 
-		// Ignore radio datagrams from the transmitter
-		MicroBitMessageBus& mb = ExtKit::global().messageBus();
-		mb.ignore(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, this, &Receiver::handleRadioDatagramReceived);
+		// Ignore radio datagrams from the receiver
+		radio::ignore(*this);
 	}
 
 	Component::doHandleComponentAction(action);
 }
 
-void Receiver::listen(char category, CategoryProtocol& protocol)
+void Transmitter::listen(char category, CategoryProtocol& protocol)
 {
 	Node* p = new CategoryRecord(category, protocol);
 	EXT_KIT_ASSERT_OR_PANIC(p, panic::kOutOfMemory);
 
 	p->linkBefore(mRoot);
+	if(!mTable.get(category)) {
+		mTable.set(category, p);	// the first record for the category is used
+	}
 }
 
-void Receiver::ignore(char category)
+void Transmitter::ignore(char category)
 {
 	Node* p = &mRoot;
 	while((p = p->next) != &mRoot) {
@@ -242,135 +323,1992 @@ void Receiver::ignore(char category)
 
 		CategoryRecord* r = static_cast<CategoryRecord*>(p);
 		if(r->category == category) {
+			if(r->isReliable()) {
+				mReliableCount--;
+			}
+			if(r->isRateLimited()) {
+				mRateLimitedCount--;
+			}
 			p = r->prev;	// rewind p
 			r->unlink();	// unlink and delete r
 			delete r;
 		}
 	}
+	mTable.set(category, 0);
+}
+
+void Transmitter::requestToSend(char category)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(!r) {
+		return;
+	}
+
+	if(mSubscriptionRequired && !r->hasLease()) {
+		Statistics::setItem(sStatisticsUnsubscribed, ++mUnsubscribedCount);
+		return;	// no subscriber
+	}
+
+	if(r->isRateLimited() && r->coalesce()) {
+		return;	// deferred until the min interval is elapsed
+	}
+
+	if(mBatchEnabled && (mWireFormat != kWireFormatText) && !r->hasLargePayload()) {
+		r->pending = true;
+		mBatchPending = true;
+		return;
+	}
+
+	r->requestToSend(/* asResponse*/ false, mWireFormat);
+}
+
+void Transmitter::setWireFormat(WireFormat wireFormat)
+{
+	mWireFormat = wireFormat;
+}
+
+WireFormat Transmitter::wireFormat()
+{
+	return mWireFormat;
+}
+
+void Transmitter::setBatchEnabled(bool enabled)
+{
+	if(!enabled) {
+		sendBatches();	// flush the pending categories
+	}
+	mBatchEnabled = enabled;
+}
+
+void Transmitter::setReliable(char category, bool reliable)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(!r || (r->isReliable() == reliable)) {
+		return;
+	}
+
+	r->setReliable(reliable);
+	if(reliable) {
+		mReliableCount++;
+	}
+	else {
+		mReliableCount--;
+	}
+}
+
+void Transmitter::setPayloadSizeMax(char category, int payloadSizeMax)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(r) {
+		r->setPayloadSizeMax(payloadSizeMax);
+	}
+}
+
+void Transmitter::setRateLimit(char category, uint16_t minInterval, uint16_t keepAliveInterval)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(!r) {
+		return;
+	}
+
+	bool wasRateLimited = r->isRateLimited();
+	r->setRateLimit(minInterval, keepAliveInterval);
+	if(!wasRateLimited && r->isRateLimited()) {
+		mRateLimitedCount++;
+	}
+	else if(wasRateLimited && !r->isRateLimited()) {
+		mRateLimitedCount--;
+	}
 }
 
-void Receiver::handleRadioDatagramReceived(MicroBitEvent /* event */)
+/* PeriodicObserver::HandlerProtocol */ void Transmitter::handlePeriodicEvent(uint32_t /* count */, PeriodicObserver::PeriodUnit /* unit */)
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "Receiver::handleRadioDatagramReceived");
+	if(mRateLimitedCount) {
+		Node* p = &mRoot;
+		while((p = p->next) != &mRoot) {
+			EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+			CategoryRecord* r = static_cast<CategoryRecord*>(p);
+			if(!r->isRateLimited()) {
+				continue;
+			}
+			if(r->isDeferredRequestDue()) {
+				r->deferred = false;
+				requestToSend(r->category);	// send the latest state
+			}
+			else if(r->isKeepAliveDue() && (!mSubscriptionRequired || r->hasLease())) {
+				r->requestToSend(/* asResponse*/ true, mWireFormat);	// a keep-alive does not change the sequence number
+			}
+		}
+	}
+
+	if(mBatchPending) {
+		sendBatches();
+	}
 
-	ManagedString received = radio::recv();
-	if(received.length() <= 1) {
+	if(mReliableCount == 0) {
 		return;
 	}
 
-	char category = received.charAt(0);
 	Node* p = &mRoot;
 	while((p = p->next) != &mRoot) {
 		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
 
 		CategoryRecord* r = static_cast<CategoryRecord*>(p);
-		if(r->category == category) {
-			r->handleRadioCommandReceived(received);
-			break;
+		if(r->isReliable()) {
+			r->retransmitIfNeeded();
 		}
 	}
 }
 
-/* PeriodicObserver::HandlerProtocol */ void Receiver::handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit)
+void Transmitter::setSubscriptionRequired(bool required)
+{
+	mSubscriptionRequired = required;
+}
+
+void Transmitter::sendBatches()
 {
+	mBatchPending = false;
+
+	uint8_t batch[kFrameSizeMax];
+	int batchSizeMax = kFrameSizeMax - relayHeaderSize();
+	int batchLength = kFrameHeaderSize;
+	int entryCount = 0;
 	Node* p = &mRoot;
 	while((p = p->next) != &mRoot) {
 		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
 
 		CategoryRecord* r = static_cast<CategoryRecord*>(p);
-		r->handlePeriodicEvent(count, unit);
+		if(!r->pending) {
+			continue;
+		}
+		r->pending = false;
+		r->noteSent();
+
+		uint8_t frame[kFrameSizeMax];
+		int frameLength = r->buildNextFrame(frame, /* asResponse */ false, mWireFormat);
+		if(batchSizeMax < batchLength + 1 + frameLength) {
+			sendBatch(batch, batchLength, entryCount);
+			batchLength = kFrameHeaderSize;
+			entryCount = 0;
+		}
+		if(batchSizeMax < kFrameHeaderSize + 1 + frameLength) {
+			sendDatagram(frame, frameLength, 1);	// too large for a batch
+			continue;
+		}
+		batch[batchLength++] = frameLength;
+		memcpy(&batch[batchLength], frame, frameLength);
+		batchLength += frameLength;
+		entryCount++;
 	}
+	sendBatch(batch, batchLength, entryCount);
 }
 
-/**	@class	Receiver::CategoryBase
-*/
-
-Receiver::CategoryBase::CategoryBase(char category)
-	: mReceiver(remoteState::Receiver::global())
-	, mCategory(category)
+void Transmitter::sendBatch(uint8_t* batch, int batchLength, int entryCount)
 {
-	mReceiver.listen(mCategory, *this);
-}
-
-/**	@class	Receiver::CategoryRecord
-*/
-
-//																						 123456789abcdef0
-EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsSyncDuration,	"\x10", " SyncDuration:  ")
-EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRecoveryCount,	"\x10", " RecoveryCount: ")
+	if(entryCount <= 0) {
+		return;
+	}
 
-/// Initial Sync Duration in 100 milliseconds
-static const uint16_t kSyncDurationInitial	= 4;
+	if(entryCount == 1) {
+		sendDatagram(&batch[kFrameHeaderSize + 1], batch[kFrameHeaderSize], 1);	// send the entry as a plain frame
+		return;
+	}
 
-Receiver::CategoryRecord::CategoryRecord(char category, Receiver::CategoryProtocol& protocol)
-	: protocol(protocol)
-	, category(category)
-	, mSequence(0)
-	, mSyncDuration(0)
-	, mSyncNextCount(0)
-	, mStatisticsSyncDuration(ManagedString(category) + ManagedString(sStatisticsSyncDuration))
-	, mStatisticsRecoveryCount(ManagedString(category) + ManagedString(sStatisticsSyncDuration))
-{
+	batch[0] = 0;
+	batch[1] = kFrameFlagBinary | kFrameFlagBatch;
+	batch[2] = entryCount;
+	sendDatagram(batch, batchLength, entryCount);
 }
 
-void Receiver::CategoryRecord::requestToSend()
+void Transmitter::sendDatagram(const uint8_t* datagram, int datagramLength, int frameCount)
 {
-	char buf[3] = { category, kMarkerRequest, 0 };
-	ManagedString s(buf);
-	radio::send(s);
+	sendFrame(datagram, datagramLength);
+
+	// Packing efficiency
+	mBatchFrameCount += frameCount;
+	mBatchDatagramCount++;
+	mBatchByteCount += datagramLength;
+	Statistics::setItem(sStatisticsBatchFrames, mBatchFrameCount);
+	Statistics::setItem(sStatisticsBatchDatagrams, mBatchDatagramCount);
+	Statistics::setItem(sStatisticsBatchFill, mBatchByteCount * 100 / (mBatchDatagramCount * kFrameSizeMax));
 }
 
-void Receiver::CategoryRecord::handleRadioCommandReceived(ManagedString& received)
+void Transmitter::debug_sendBenchmark(int repeatCount)
 {
-//	debug_sendLine(EXT_KIT_DEBUG_TRACE "Receiver::Record::handleRadioCommandReceived");
+	EXT_KIT_ASSERT(0 < repeatCount);
 
-	char marker = received.charAt(1);
-	if((marker != kMarkerResponse) && (marker != kMarkerNotification)) {
-		return;	// invalid command
-	}
+	debug_sendLine(EXT_KIT_DEBUG_INFO "remoteState benchmark: repeats = ", ManagedString(repeatCount).toCharArray());
+	debug_sendLine(EXT_KIT_DEBUG_INFO "- on-air time [us] at 1 Mbps is about (bytes + 12) x 8");
 
-	uint8_t sequence = string::numberForHexString(received, 2);
-	if(!(mSequence.set(sequence))) {
-		uint16_t tmp = mSyncDuration;
-		if(tmp < 0x8000) {
-			mSyncDuration = tmp + tmp;
-			mSyncNextCount = 0;
-			Statistics::setItem(mStatisticsSyncDuration, mSyncDuration);
-		}
-		return;	// sequence number is not changed
-	}
+	Node* p = &mRoot;
+	while((p = p->next) != &mRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
 
-	mSyncDuration = kSyncDurationInitial;
-	mSyncNextCount = 0;
-	Statistics::setItem(mStatisticsSyncDuration, mSyncDuration);
+		CategoryRecord* r = static_cast<CategoryRecord*>(p);
 
-	if(marker == kMarkerResponse) {
-		Statistics::incrementItem(mStatisticsRecoveryCount);
-	//	debug_sendLine(EXT_KIT_DEBUG_EVENT "RemoteState is rocovered by a response");
+		// Text: build and parse the command using ManagedString
+		int textLength = 0;
+		time::MicroTime start = time::microTime();
+		for(int n = 0; n < repeatCount; n++) {
+			ManagedString s = r->buildText(/* asResponse */ true);
+			textLength = s.length();
+			string::numberForHexString(s, 2);
+		}
+		time::MicroTime durationForText = time::microTime() - start;
+
+		// Binary: build and parse the frame on the stack
+		int frameLength = 0;
+		uint8_t frame[kFrameSizeMax];
+		FrameHeader header;
+		start = time::microTime();
+		for(int n = 0; n < repeatCount; n++) {
+			frameLength = r->buildFrame(frame, /* asResponse */ true);
+			decodeFrame(frame, frameLength, header);
+		}
+		time::MicroTime durationForBinary = time::microTime() - start;
+
+		char category[2] = { r->category, 0 };
+		debug_sendLine(EXT_KIT_DEBUG_INFO "- category '", category, "'");
+		debug_sendLine(EXT_KIT_DEBUG_INFO "  text   bytes, build+parse [us]: ", ManagedString(textLength).toCharArray(), ", ", ManagedString((int) durationForText).toCharArray());
+		debug_sendLine(EXT_KIT_DEBUG_INFO "  binary bytes, build+parse [us]: ", ManagedString(frameLength).toCharArray(), ", ", ManagedString((int) durationForBinary).toCharArray());
 	}
+}
 
-	protocol.handleRemoteState(received);
+Transmitter::CategoryRecord* Transmitter::findCategoryRecord(char category)
+{
+	Node* p = mTable.get(category);
+	EXT_KIT_ASSERT_OR_PANIC(!p || p->isValid(), panic::kCorruptedNode);
+
+	return static_cast<CategoryRecord*>(p);
 }
 
-void Receiver::CategoryRecord::handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit /* unit */)
+/* radio::DatagramProtocol */ void Transmitter::handleRadioDatagram(const uint8_t* frame, int frameLength)
 {
-	if(mSyncDuration == 0) {
-		return;	// synchronization is not started
+	if(frameLength <= 1) {
+		return;
 	}
 
-	if(mSyncNextCount == 0) {
-		mSyncNextCount = count + mSyncDuration;
-		return;	// the next count is not set
+	// Unwrap a relay envelope
+	RelayHeader relayHeader;
+	int innerLength = decodeRelayEnvelope(frame, frameLength, relayHeader);
+	if(0 < innerLength) {
+		frame += kRelayHeaderSize;
+		frameLength = innerLength;
 	}
 
-	uint32_t remainingCount = mSyncNextCount - count;
-	if(remainingCount <= (uint32_t) INT32_MAX) {
-		return;	// the next count is not reached
+	CategoryRecord* r = findCategoryRecord(frame[0]);
+	if(!r) {
+		return;
+	}
+
+	// Accept acknowledgements for the reliable mode
+	uint8_t flags = frame[1];
+	if((flags & (kFrameFlagBinary | kFrameFlagAck)) == (kFrameFlagBinary | kFrameFlagAck)) {
+		if(kFrameHeaderSize <= frameLength) {
+			r->handleAckReceived(frame[2]);
+		}
+		return;
+	}
+
+	// Accept requests to resend fragments
+	if(((flags & (kFrameFlagBinary | kFrameFlagFragment)) == (kFrameFlagBinary | kFrameFlagFragment)) && ((flags & kFrameKindMask) == kFrameKindRequest)) {
+		if(kFrameHeaderSize + 2 <= frameLength) {
+			r->handleResendRequestReceived(frame[2], frame[3] | (frame[4] << 8));
+		}
+		return;
+	}
+
+	// Accept leases for the subscriptions
+	if((flags & (kFrameFlagBinary | kFrameFlagLease | kFrameKindMask)) == (kFrameFlagBinary | kFrameFlagLease | kFrameKindRequest)) {
+		if((kFrameHeaderSize + 1 <= frameLength) && r->handleLeaseReceived(frame[kFrameHeaderSize])) {
+			r->requestToSend(/* asResponse*/ true, mWireFormat);	// a new subscriber receives the current state
+		}
+		return;
+	}
+
+	// Accept requests in both formats
+	bool isRequest;
+	if(flags & kFrameFlagBinary) {
+		isRequest = ((flags & kFrameKindMask) == kFrameKindRequest);
+	}
+	else {
+		isRequest = (flags == (uint8_t) kMarkerRequest);
+	}
+	if(!isRequest) {
+		return;
+	}
+
+	r->requestToSend(/* asResponse*/ true, mWireFormat);	// a response is always a keyframe
+}
+
+/**	@class	Transmitter::CategoryBase
+*/
+
+Transmitter::CategoryBase::CategoryBase(char category)
+	: mTransmitter(remoteState::Transmitter::global())
+	, mCategory(category)
+{
+	mTransmitter.listen(mCategory, *this);
+}
+
+/**	@class	Transmitter::CategoryRecord
+*/
+
+//																						 123456789abcdef0
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRetransmitCount,		"\x10", " Retransmits:   ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsUndeliveredCount,	"\x10", " Undelivered:   ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRetransmitTimeout,	"\x10", " RTO (ms):      ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsSentCount,			"\x10", " Sent:          ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsCoalescedCount,		"\x10", " Coalesced:     ")
+
+/// Retransmit Window Size
+static const int kRetransmitWindowSize		= 4;
+
+/// Max Retry Count for a frame in the retransmit window
+static const int kRetryCountMax				= 6;
+
+/// Initial Retransmission Timeout in milliseconds
+static const uint16_t kRetransmitTimeoutInitial	= 100;
+
+/// Min Retransmission Timeout in milliseconds, which is the period of the retransmit check
+static const uint16_t kRetransmitTimeoutMin		= 20;
+
+/// Max Retransmission Timeout in milliseconds
+static const uint16_t kRetransmitTimeoutMax		= 2000;
+
+Transmitter::CategoryRecord::CategoryRecord(char category, Transmitter::CategoryProtocol& protocol)
+	: protocol(protocol)
+	, category(category)
+	, pending(false)
+	, leased(false)
+	, leaseExpiry(0)
+	, deferred(false)
+	, mSequence(0)
+	, mStartAnnounced(false)
+	, mSnapshotLength(-1)
+	, mSnapshot(0)
+	, mWindow(0)
+	, mWindowCount(0)
+	, mSmoothedRtt(0)
+	, mRttVariance(0)
+	, mRetransmitTimeout(kRetransmitTimeoutInitial)
+	, mRetransmitCount(0)
+	, mUndeliveredCount(0)
+	, mLargePayload(0)
+	, mLargePayloadSize(0)
+	, mLargePayloadLength(0)
+	, mMinInterval(0)
+	, mKeepAliveInterval(0)
+	, mLastSentTime(0)
+	, mSentCount(0)
+	, mCoalescedCount(0)
+{
+}
+
+Transmitter::CategoryRecord::~CategoryRecord()
+{
+	delete[] mSnapshot;
+	delete[] mWindow;
+	delete[] mLargePayload;
+}
+
+void Transmitter::CategoryRecord::requestToSend(bool asResponse, WireFormat wireFormat)
+{
+	noteSent();
+
+	if((wireFormat != kWireFormatText) && mLargePayload) {
+		if(!asResponse) {
+			mSequence++;
+			mLargePayloadLength = protocol.packRemoteState(mLargePayload, mLargePayloadSize);
+		}
+		else if(mLargePayloadLength == 0) {
+			mLargePayloadLength = protocol.packRemoteState(mLargePayload, mLargePayloadSize);
+		}
+		sendFragments(asResponse, 0xffff);
+	}
+	else if(wireFormat != kWireFormatText) {
+		uint8_t frame[kFrameSizeMax];
+		int frameLength = buildNextFrame(frame, asResponse, wireFormat);
+		sendFrame(frame, frameLength);
+	}
+	else {
+		if(!asResponse) {
+			mSequence++;
+		}
+		ManagedString s = buildText(asResponse);
+		if(s.length() <= kFrameSizeMax) {
+			radio::send(s);
+		}
+		else {
+			// Fall back to a binary keyframe, which is accepted by the receivers in any wire format, since the text command does not fit in a datagram
+			uint8_t frame[kFrameSizeMax];
+			int frameLength = buildFrame(frame, asResponse, /* delta */ false);
+			sendFrame(frame, frameLength);
+		}
+	}
+}
+
+int /* frameLength */ Transmitter::CategoryRecord::buildNextFrame(uint8_t* /* OUT */ frame, bool asResponse, WireFormat wireFormat)
+{
+	if(!asResponse) {
+		mSequence++;
+		if(!mStartAnnounced) {
+			// Send the first notification as a response, which the receivers apply even if the sequence number lies in their duplicate windows
+			mStartAnnounced = true;
+			mSnapshotLength = -1;	// pack the current state instead of resending the snapshot
+			asResponse = true;
+		}
+	}
+	int frameLength = buildFrame(frame, asResponse, wireFormat == kWireFormatBinaryDelta);
+	if(isReliable()) {
+		frame[1] |= kFrameFlagAckRequested;
+		if(!asResponse) {
+			retain(frame, frameLength);	// a response is not retained because it is requested again if lost
+		}
+	}
+	return frameLength;
+}
+
+ManagedString Transmitter::CategoryRecord::buildText(bool asResponse)
+{
+	ManagedString s(category);
+	char sequenceMarker = asResponse ? kMarkerResponse : kMarkerNotification;
+	s =	s + string::hex(mSequence, sequenceMarker);
+	s = s + protocol.remoteState();
+	return s;
+}
+
+int /* frameLength */ Transmitter::CategoryRecord::buildFrame(uint8_t* /* OUT */ frame, bool asResponse, bool delta)
+{
+	uint8_t* payload = &frame[kFrameHeaderSize];
+	FrameHeader header = { category, asResponse ? kFrameKindResponse : kFrameKindNotification, mSequence };
+	if(!delta) {
+		int payloadLength = protocol.packRemoteState(payload, kPayloadSizeMax);
+		return encodeFrame(frame, header, payloadLength);
+	}
+
+	if(!mSnapshot) {
+		mSnapshot = new uint8_t[kPayloadSizeMax];
+		EXT_KIT_ASSERT_OR_PANIC(mSnapshot, panic::kOutOfMemory);
+	}
+
+	if(asResponse && (0 <= mSnapshotLength)) {
+		// Resend the keyframe for the current sequence number, so that every receiver shares the same base for the next delta
+		memcpy(payload, mSnapshot, mSnapshotLength);
+		return encodeFrame(frame, header, mSnapshotLength);
+	}
+
+	int payloadLength = protocol.packRemoteState(payload, kPayloadSizeMax);
+	int deltaLength = -1;
+	uint8_t buf[kPayloadSizeMax];
+	if(!asResponse && (mSnapshotLength == payloadLength)) {
+		deltaLength = encodeDelta(mSnapshot, payload, payloadLength, buf);
+	}
+	memcpy(mSnapshot, payload, payloadLength);
+	mSnapshotLength = payloadLength;
+	if(deltaLength < 0) {
+		return encodeFrame(frame, header, payloadLength);	// keyframe
+	}
+
+	memcpy(payload, buf, deltaLength);
+	header.flags |= kFrameFlagDelta;
+	return encodeFrame(frame, header, deltaLength);
+}
+
+void Transmitter::CategoryRecord::setReliable(bool reliable)
+{
+	if(!reliable) {
+		delete[] mWindow;
+		mWindow = 0;
+		mWindowCount = 0;
+		return;
+	}
+
+	if(!mWindow) {
+		mWindow = new RetransmitEntry[kRetransmitWindowSize];
+		EXT_KIT_ASSERT_OR_PANIC(mWindow, panic::kOutOfMemory);
+
+		mStatisticsRetransmitCount = ManagedString(category) + ManagedString(sStatisticsRetransmitCount);
+		mStatisticsUndeliveredCount = ManagedString(category) + ManagedString(sStatisticsUndeliveredCount);
+		mStatisticsRetransmitTimeout = ManagedString(category) + ManagedString(sStatisticsRetransmitTimeout);
+	}
+}
+
+void Transmitter::CategoryRecord::retain(const uint8_t* frame, int frameLength)
+{
+	if(kRetransmitWindowSize <= mWindowCount) {
+		// Give up the oldest frame. The latest frame carries the latest state anyway.
+		removeEntries(1);
+		Statistics::setItem(mStatisticsUndeliveredCount, ++mUndeliveredCount);
+	}
+
+	RetransmitEntry& e = mWindow[mWindowCount++];
+	memcpy(e.frame, frame, frameLength);
+	e.frameLength = frameLength;
+	e.retryCount = 0;
+	e.sentTime = time::systemTime();
+	e.deadline = e.sentTime + mRetransmitTimeout;
+}
+
+void Transmitter::CategoryRecord::removeEntries(int count)
+{
+	EXT_KIT_ASSERT(count <= mWindowCount);
+
+	mWindowCount -= count;
+	memmove(&mWindow[0], &mWindow[count], mWindowCount * sizeof(RetransmitEntry));
+}
+
+void Transmitter::CategoryRecord::handleAckReceived(uint8_t sequence)
+{
+	if(!isReliable()) {
+		return;
+	}
+
+	// The ack is cumulative. Remove the frames up to the sequence number.
+	int count = 0;
+	for(int i = 0; i < mWindowCount; i++) {
+		RetransmitEntry& e = mWindow[i];
+		int8_t distance = sequence - e.frame[2];
+		if(distance < 0) {
+			break;	// newer than the ack
+		}
+		if((distance == 0) && (e.retryCount == 0)) {
+			updateRetransmitTimeout(time::systemTime() - e.sentTime);	// sample only frames not retransmitted (Karn's algorithm)
+		}
+		radio::reportDelivery();
+		count++;
+	}
+	removeEntries(count);
+}
+
+void Transmitter::CategoryRecord::updateRetransmitTimeout(time::SystemTime sample)
+{
+	if(0xffff < sample) {
+		sample = 0xffff;
+	}
+
+	// Smoothed RTT and RTT variance as described in RFC 6298
+	if(mSmoothedRtt == 0) {
+		mSmoothedRtt = sample ? sample : 1;
+		mRttVariance = sample / 2;
+	}
+	else {
+		int diff = (int) mSmoothedRtt - (int) sample;
+		mRttVariance = (3 * mRttVariance + (diff < 0 ? -diff : diff)) / 4;
+		mSmoothedRtt = (7 * mSmoothedRtt + sample) / 8;
+	}
+
+	uint32_t timeout = mSmoothedRtt + 4 * mRttVariance;
+	if(timeout < kRetransmitTimeoutMin) {
+		timeout = kRetransmitTimeoutMin;
+	}
+	else if(kRetransmitTimeoutMax < timeout) {
+		timeout = kRetransmitTimeoutMax;
+	}
+	mRetransmitTimeout = timeout;
+	Statistics::setItem(mStatisticsRetransmitTimeout, mRetransmitTimeout);
+}
+
+void Transmitter::CategoryRecord::retransmitIfNeeded()
+{
+	int i = 0;
+	while(i < mWindowCount) {
+		RetransmitEntry& e = mWindow[i];
+		if(!time::isElapsed(e.deadline)) {
+			i++;
+			continue;
+		}
+
+		if(kRetryCountMax <= e.retryCount) {
+			// Give up the frame
+			mWindowCount--;
+			memmove(&mWindow[i], &mWindow[i + 1], (mWindowCount - i) * sizeof(RetransmitEntry));
+			Statistics::setItem(mStatisticsUndeliveredCount, ++mUndeliveredCount);
+			continue;
+		}
+
+		radio::reportLoss();
+		sendFrame(e.frame, e.frameLength);
+		e.retryCount++;
+		uint32_t timeout = (uint32_t) mRetransmitTimeout << e.retryCount;	// exponential backoff
+		e.deadline = time::systemTime() + ((timeout < kRetransmitTimeoutMax) ? timeout : kRetransmitTimeoutMax);
+		Statistics::setItem(mStatisticsRetransmitCount, ++mRetransmitCount);
+		i++;
+	}
+}
+
+void Transmitter::CategoryRecord::setPayloadSizeMax(int payloadSizeMax)
+{
+	delete[] mLargePayload;
+	mLargePayload = 0;
+	mLargePayloadSize = 0;
+	mLargePayloadLength = 0;
+	if(payloadSizeMax <= kPayloadSizeMax) {
+		return;	// fits in a frame
+	}
+
+	if(kLargePayloadSizeMax < payloadSizeMax) {
+		payloadSizeMax = kLargePayloadSizeMax;
+	}
+	mLargePayload = new uint8_t[payloadSizeMax];
+	EXT_KIT_ASSERT_OR_PANIC(mLargePayload, panic::kOutOfMemory);
+
+	mLargePayloadSize = payloadSizeMax;
+}
+
+void Transmitter::CategoryRecord::sendFragments(bool asResponse, uint16_t fragmentMask)
+{
+	uint8_t frame[kFrameSizeMax];
+	uint8_t* payload = &frame[kFrameHeaderSize];
+	FrameHeader header = { category, asResponse ? kFrameKindResponse : kFrameKindNotification, mSequence };
+	int length = mLargePayloadLength;
+	if(length <= kPayloadSizeMax) {
+		// Send as a plain frame
+		memcpy(payload, mLargePayload, length);
+		sendFrame(frame, encodeFrame(frame, header, length));
+		return;
+	}
+
+	header.flags |= kFrameFlagFragment;
+	int fragmentCount = (length + kFragmentPayloadSize - 1) / kFragmentPayloadSize;
+	for(int i = 0; i < fragmentCount; i++) {
+		if(!(fragmentMask & (1 << i))) {
+			continue;
+		}
+
+		// Pace the fragments, since they outnumber the entries of the transmit queue
+		if(radio::isContentionEnabled()) {
+			radio::waitForTxQueue();
+		}
+
+		int offset = i * kFragmentPayloadSize;
+		int fragmentLength = (i < fragmentCount - 1) ? kFragmentPayloadSize : length - offset;
+		payload[0] = (i << 4) | (fragmentCount - 1);
+		memcpy(&payload[1], &mLargePayload[offset], fragmentLength);
+		sendFrame(frame, encodeFrame(frame, header, 1 + fragmentLength));
+	}
+}
+
+void Transmitter::CategoryRecord::handleResendRequestReceived(uint8_t sequence, uint16_t fragmentMask)
+{
+	if(!mLargePayload || (mLargePayloadLength == 0) || (sequence != mSequence)) {
+		return;	// the payload is already replaced by a newer one
+	}
+
+	sendFragments(/* asResponse */ false, fragmentMask);
+}
+
+void Transmitter::CategoryRecord::setRateLimit(uint16_t minInterval, uint16_t keepAliveInterval)
+{
+	if(!isRateLimited()) {
+		mStatisticsSentCount = ManagedString(category) + ManagedString(sStatisticsSentCount);
+		mStatisticsCoalescedCount = ManagedString(category) + ManagedString(sStatisticsCoalescedCount);
+		mLastSentTime = time::systemTime();
+	}
+
+	mMinInterval = minInterval;
+	mKeepAliveInterval = keepAliveInterval;
+	if(!mMinInterval) {
+		deferred = false;
+	}
+}
+
+bool Transmitter::CategoryRecord::coalesce()
+{
+	if(!mMinInterval || time::isElapsed(mLastSentTime + mMinInterval)) {
+		return false;
+	}
+
+	if(deferred) {
+		Statistics::setItem(mStatisticsCoalescedCount, ++mCoalescedCount);	// merged into the deferred request
+	}
+	deferred = true;
+	return true;
+}
+
+bool Transmitter::CategoryRecord::isDeferredRequestDue()
+{
+	return deferred && time::isElapsed(mLastSentTime + mMinInterval);
+}
+
+bool Transmitter::CategoryRecord::isKeepAliveDue()
+{
+	return mKeepAliveInterval && time::isElapsed(mLastSentTime + mKeepAliveInterval);
+}
+
+void Transmitter::CategoryRecord::noteSent()
+{
+	deferred = false;
+	if(!isRateLimited()) {
+		return;
+	}
+
+	mLastSentTime = time::systemTime();
+	Statistics::setItem(mStatisticsSentCount, ++mSentCount);
+}
+
+bool Transmitter::CategoryRecord::handleLeaseReceived(uint8_t duration)
+{
+	bool renewed = hasLease();
+	time::SystemTime expiry = time::systemTime() + duration * 1000;
+	if(!renewed || ((int32_t) (expiry - leaseExpiry) > 0)) {
+		leaseExpiry = expiry;	// the longest lease among the receivers is kept
+	}
+	leased = true;
+	return !renewed;
+}
+
+/**	@class	Transmitter::CategoryProtocol
+*/
+
+int /* payloadLength */ Transmitter::CategoryProtocol::packRemoteState(uint8_t* /* OUT */ payload, int payloadSizeMax)
+{
+	ManagedString s = remoteState();
+	int length = s.length();
+	if(payloadSizeMax < length) {
+		length = payloadSizeMax;
+	}
+	memcpy(payload, s.toCharArray(), length);
+	return length;
+}
+
+/**	@class	Receiver
+*/
+
+//																		 123456789abcdef012345
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsReassembled,		"\x15", "Rx Reassembled:      ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsReassemblyDrops,	"\x15", "Rx Reassembly Drops: ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsResendRequests,	"\x15", "Rx Resend Requests:  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRelayHops,		"\x15", "Rx Relay Hops:       ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRelayAge,		"\x15", "Rx Relay Age (ms):   ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRelayDuplicates,	"\x15", "Rx Relay Duplicates: ")
+
+/// Reassembly Pool Size in bytes, which bounds the total size of the reassembly buffers
+static const uint16_t kReassemblyPoolSize		= 512;
+
+/// Reassembly Timeout in milliseconds since the last fragment received
+static const time::SystemTime kReassemblyTimeout	= 300;
+
+/// Max number of resend requests for a payload
+static const int kResendCountMax				= 3;
+
+Receiver* Receiver::sGlobal = 0;
+
+Receiver& Receiver::global()
+{
+	EXT_KIT_ASSERT(sGlobal);
+
+	return *sGlobal;
+}
+
+Receiver::Receiver()
+	: Component("Receiver")
+	, mReassemblyPoolUsed(0)
+	, mWireFormat(kWireFormatDefault)
+	, mLeaseDuration(0)
+	, mLeaseNextCount(0)
+	, mRelayedCacheNext(0)
+	, mRelayedDuplicateCount(0)
+{
+	memset(mReassemblySlots, 0, sizeof(mReassemblySlots));
+	memset(mRelayedCache, 0, sizeof(mRelayedCache));
+
+	MicroBitRadio* r = ExtKit::global().radio();
+	EXT_KIT_ASSERT(r);
+
+	EXT_KIT_ASSERT(!sGlobal);
+
+	sGlobal = this;
+}
+
+Receiver::~Receiver()
+{
+	if(sGlobal == this) {
+		sGlobal = 0;
+	}
+}
+
+/* Component */ void Receiver::doHandleComponentAction(Action action)
+{
+	if(action == kStart) {
+		radio::prepare();
+
+		// Listen to radio datagrams from the transmitter
+		radio::listen(*this);
+
+		// Listen Periodic Observer
+		PeriodicObserver::listen(PeriodicObserver::kUnit100ms, *this, PeriodicObserver::kPriorityLow);
+
+		// Announce the leases of the categories listened before the start, now that the radio is prepared
+		mLeaseNextCount = 0;
+	}
+	else if(action == kStop) {
+		// Ignore Periodic Observer
+		PeriodicObserver::ignore(PeriodicObserver::kUnit100ms, *this);
+
+		// Ignore radio datagrams from the transmitter
+		radio::ignore(*this);
+	}
+
+	Component::doHandleComponentAction(action);
+}
+
+void Receiver::listen(char category, CategoryProtocol& protocol)
+{
+	Node* p = new CategoryRecord(category, protocol);
+	EXT_KIT_ASSERT_OR_PANIC(p, panic::kOutOfMemory);
+
+	p->linkBefore(mRoot);
+	if(!mTable.get(category)) {
+		mTable.set(category, p);	// the first record for the category is used
+		mLeaseNextCount = 0;	// announce on the next periodic event, which is not issued before kStart
+	}
+}
+
+void Receiver::ignore(char category)
+{
+	Node* p = &mRoot;
+	while((p = p->next) != &mRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		CategoryRecord* r = static_cast<CategoryRecord*>(p);
+		if(r->category == category) {
+			for(int i = 0; i < kReassemblySlotCount; i++) {
+				if(mReassemblySlots[i].record == r) {
+					freeReassemblySlot(mReassemblySlots[i]);
+				}
+			}
+			p = r->prev;	// rewind p
+			r->unlink();	// unlink and delete r
+			delete r;
+		}
+	}
+	mTable.set(category, 0);
+}
+
+void Receiver::setWireFormat(WireFormat wireFormat)
+{
+	mWireFormat = wireFormat;
+}
+
+WireFormat Receiver::wireFormat()
+{
+	return mWireFormat;
+}
+
+void Receiver::setStaleTimeout(char category, uint16_t timeout)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(r) {
+		r->setStaleTimeout(timeout);
+	}
+}
+
+bool Receiver::isStale(char category)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	return r && r->isStale();
+}
+
+void Receiver::setPrediction(char category, int fieldCount, PredictionMode mode, uint16_t horizon)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(r) {
+		r->setPrediction(fieldCount, mode, horizon);
+	}
+}
+
+void Receiver::updateFields(char category, const int16_t* fields)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(r) {
+		r->updateFields(fields);
+	}
+}
+
+bool Receiver::linkQuality(char category, LinkQuality& /* OUT */ quality)
+{
+	CategoryRecord* r = findCategoryRecord(category);
+	if(!r) {
+		return false;
+	}
+
+	r->getLinkQuality(quality);
+	return true;
+}
+
+void Receiver::debug_sendLinkQuality()
+{
+	debug_sendLine("# Link Quality", false);
+	if(!sGlobal) {
+		debug_sendLine("- Receiver is not available", false);
+		return;
+	}
+
+	Node* p = &sGlobal->mRoot;
+	while((p = p->next) != &sGlobal->mRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		CategoryRecord* r = static_cast<CategoryRecord*>(p);
+		if(sGlobal->mTable.get(r->category) != r) {
+			continue;	// not used for the category
+		}
+
+		LinkQuality q;
+		r->getLinkQuality(q);
+		char category[2] = { r->category, 0 };
+		debug_sendLine("## Category '", category, "'", false);
+		debug_sendLine("- received, lost:       ", ManagedString((int) q.receivedCount).toCharArray(), ", ", ManagedString((int) q.lostCount).toCharArray(), false);
+		debug_sendLine("- loss rate [permil]:   ", ManagedString((int) q.lossRate).toCharArray(), false);
+		debug_sendLine("- jitter [ms]:          ", ManagedString((int) q.jitter).toCharArray(), false);
+		debug_sendLine("- rssi:                 ", ManagedString((int) q.rssi).toCharArray(), false);
+		debug_sendLine("- age [ms]:             ", (q.age == UINT32_MAX) ? "-" : ManagedString((int) q.age).toCharArray(), false);
+		debug_sendLine("- recovery latency [ms]:", ManagedString((int) q.recoveryLatency).toCharArray(), false);
+	}
+}
+
+void Receiver::setLeaseDuration(uint8_t seconds)
+{
+	mLeaseDuration = seconds;
+	mLeaseNextCount = 0;	// announce on the next periodic event
+}
+
+Receiver::CategoryRecord* Receiver::findCategoryRecord(char category)
+{
+	Node* p = mTable.get(category);
+	EXT_KIT_ASSERT_OR_PANIC(!p || p->isValid(), panic::kCorruptedNode);
+
+	return static_cast<CategoryRecord*>(p);
+}
+
+/* radio::DatagramProtocol */ void Receiver::handleRadioDatagram(const uint8_t* frame, int frameLength)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "Receiver::handleRadioDatagram");
+
+	if((frameLength <= 1) || (kFrameSizeMax < frameLength)) {
+		return;
+	}
+
+	// Unwrap a relay envelope
+	RelayHeader relayHeader;
+	int innerLength = decodeRelayEnvelope(frame, frameLength, relayHeader);
+	if(0 < innerLength) {
+		// Drop the copies of a frame already received before the delta and sync logic, whether directly or from a relay
+		if(isRelayedDuplicate(relayHeader, &frame[kRelayHeaderSize], innerLength)) {
+			Statistics::setItem(sStatisticsRelayDuplicates, ++mRelayedDuplicateCount);
+			return;
+		}
+
+		Statistics::setItem(sStatisticsRelayHops, relayHeader.hops);
+		Statistics::setItem(sStatisticsRelayAge, relayHeader.age);
+		frame += kRelayHeaderSize;
+		frameLength = innerLength;
+	}
+
+	if((frame[1] & (kFrameFlagBinary | kFrameFlagBatch | kFrameKindMask)) == (kFrameFlagBinary | kFrameFlagBatch)) {
+		// Demultiplex the entries of the batch
+		int entryCount = frame[2];
+		int i = kFrameHeaderSize;
+		while((0 < entryCount--) && (i < frameLength)) {
+			int entryLength = frame[i++];
+			if(frameLength < i + entryLength) {
+				break;	// invalid entry length
+			}
+			handleDatagram(&frame[i], entryLength);
+			i += entryLength;
+		}
+		return;
+	}
+
+	handleDatagram(frame, frameLength);
+}
+
+bool Receiver::isRelayedDuplicate(const RelayHeader& header, const uint8_t* frame, int frameLength)
+{
+	char category = frame[0];
+	uint8_t sequence = (kFrameHeaderSize <= frameLength) ? frame[2] : 0;
+	uint8_t checkSum = relayCheckSum(frame, frameLength);
+
+	for(int i = 0; i < kRelayedCacheSize; i++) {
+		RelayedEntry& e = mRelayedCache[i];
+		if(e.used && (e.origin == header.origin) && (e.category == category) && (e.sequence == sequence) && (e.checkSum == checkSum)) {
+			// A retransmission in the reliable mode is left to the duplicate window of the category, which acks it again
+			return !(frame[1] & kFrameFlagAckRequested);
+		}
+	}
+
+	// Replace the oldest entry
+	RelayedEntry& e = mRelayedCache[mRelayedCacheNext];
+	mRelayedCacheNext = (mRelayedCacheNext + 1) % kRelayedCacheSize;
+	e.origin = header.origin;
+	e.category = category;
+	e.sequence = sequence;
+	e.checkSum = checkSum;
+	e.used = true;
+	return false;
+}
+
+void Receiver::handleDatagram(const uint8_t* frame, int frameLength)
+{
+	if(frameLength <= 1) {
+		return;
+	}
+
+	CategoryRecord* r = findCategoryRecord(frame[0]);
+	if(!r) {
+		return;
+	}
+
+	// Accept both formats
+	if(frame[1] & kFrameFlagBinary) {
+		r->handleRadioFrameReceived(frame, frameLength);
+	}
+	else {
+		ManagedString received((const char*) frame, frameLength);
+		r->handleRadioCommandReceived(received);
+	}
+}
+
+void Receiver::handleFragmentReceived(CategoryRecord& record, const FrameHeader& header, const uint8_t* payload, int payloadLength)
+{
+	if(payloadLength < 2) {
+		return;	// invalid fragment
+	}
+
+	int fragmentIndex = payload[0] >> 4;
+	int fragmentCount = (payload[0] & 0xf) + 1;
+	int fragmentLength = payloadLength - 1;
+	if((fragmentCount <= fragmentIndex) || ((fragmentIndex < fragmentCount - 1) && (fragmentLength != kFragmentPayloadSize))) {
+		return;	// invalid fragment
+	}
+
+	// Find the slot for the category
+	ReassemblySlot* slot = 0;
+	ReassemblySlot* freeSlot = 0;
+	for(int i = 0; i < kReassemblySlotCount; i++) {
+		ReassemblySlot& t = mReassemblySlots[i];
+		if(t.record == &record) {
+			if((t.header.sequence == header.sequence) && (t.fragmentCount == fragmentCount)) {
+				slot = &t;
+				break;
+			}
+			freeReassemblySlot(t);	// replaced by a newer payload
+		}
+		if(!t.record && !freeSlot) {
+			freeSlot = &t;
+		}
+	}
+
+	if(!slot) {
+		uint16_t size = fragmentCount * kFragmentPayloadSize;
+		if(!freeSlot || (kReassemblyPoolSize < mReassemblyPoolUsed + size)) {
+			Statistics::incrementItem(sStatisticsReassemblyDrops);	// the pool is exhausted
+			return;
+		}
+
+		slot = freeSlot;
+		slot->buffer = new uint8_t[size];
+		EXT_KIT_ASSERT_OR_PANIC(slot->buffer, panic::kOutOfMemory);
+
+		mReassemblyPoolUsed += size;
+		slot->record = &record;
+		slot->header = header;
+		slot->fragmentCount = fragmentCount;
+		slot->resendCount = 0;
+		slot->receivedMask = 0;
+		slot->length = 0;
+	}
+
+	uint16_t bit = 1 << fragmentIndex;
+	if(slot->receivedMask & bit) {
+		return;	// duplicate fragment
+	}
+
+	memcpy(&slot->buffer[fragmentIndex * kFragmentPayloadSize], &payload[1], fragmentLength);
+	slot->receivedMask |= bit;
+	slot->deadline = time::systemTime() + kReassemblyTimeout;
+	if(fragmentIndex == fragmentCount - 1) {
+		slot->length = fragmentIndex * kFragmentPayloadSize + fragmentLength;
+	}
+
+	uint16_t fullMask = (1 << fragmentCount) - 1;
+	if(slot->receivedMask == fullMask) {
+		Statistics::incrementItem(sStatisticsReassembled);
+		FrameHeader h = slot->header;
+		h.flags &= ~kFrameFlagFragment;
+		record.handleReassembledPayload(h, slot->buffer, slot->length);
+		freeReassemblySlot(*slot);
+	}
+	else if(fragmentIndex == fragmentCount - 1) {
+		requestToResend(*slot);	// the last fragment is received but some are missing
+	}
+}
+
+void Receiver::requestToResend(ReassemblySlot& slot)
+{
+	uint16_t missingMask = ~slot.receivedMask & ((1 << slot.fragmentCount) - 1);
+	uint8_t frame[kFrameHeaderSize + 2];
+	FrameHeader header = { slot.header.category, kFrameKindRequest | kFrameFlagFragment, slot.header.sequence };
+	frame[kFrameHeaderSize] = missingMask & 0xff;
+	frame[kFrameHeaderSize + 1] = missingMask >> 8;
+	sendFrame(frame, encodeFrame(frame, header, 2));
+	slot.resendCount++;
+	Statistics::incrementItem(sStatisticsResendRequests);
+}
+
+void Receiver::checkReassemblyTimeouts()
+{
+	for(int i = 0; i < kReassemblySlotCount; i++) {
+		ReassemblySlot& slot = mReassemblySlots[i];
+		if(!slot.record || !time::isElapsed(slot.deadline)) {
+			continue;
+		}
+
+		if(slot.resendCount < kResendCountMax) {
+			requestToResend(slot);
+			slot.deadline = time::systemTime() + kReassemblyTimeout;
+		}
+		else {
+			Statistics::incrementItem(sStatisticsReassemblyDrops);	// timed out
+			freeReassemblySlot(slot);
+		}
+	}
+}
+
+void Receiver::freeReassemblySlot(ReassemblySlot& slot)
+{
+	if(!slot.record) {
+		return;
+	}
+
+	mReassemblyPoolUsed -= slot.fragmentCount * kFragmentPayloadSize;
+	delete[] slot.buffer;
+	slot.buffer = 0;
+	slot.record = 0;
+}
+
+/* PeriodicObserver::HandlerProtocol */ void Receiver::handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit unit)
+{
+	checkReassemblyTimeouts();
+
+	// Renew the leases at half the duration
+	bool renewsLeases = false;
+	if(mLeaseDuration) {
+		uint32_t remainingCount = mLeaseNextCount - count;
+		if((mLeaseNextCount == 0) || ((uint32_t) INT32_MAX < remainingCount)) {
+			mLeaseNextCount = count + mLeaseDuration * 10 / 2;
+			renewsLeases = true;
+		}
+	}
+
+	Node* p = &mRoot;
+	while((p = p->next) != &mRoot) {
+		EXT_KIT_ASSERT_OR_PANIC(p && p->isValid(), panic::kCorruptedNode);
+
+		CategoryRecord* r = static_cast<CategoryRecord*>(p);
+		if(renewsLeases && (mTable.get(r->category) == r)) {
+			r->sendLease(mLeaseDuration);
+		}
+		r->handlePeriodicEvent(count, unit);
+	}
+}
+
+/**	@class	Receiver::CategoryBase
+*/
+
+Receiver::CategoryBase::CategoryBase(char category)
+	: mReceiver(remoteState::Receiver::global())
+	, mCategory(category)
+{
+	mReceiver.listen(mCategory, *this);
+}
+
+/**	@class	Receiver::CategoryProtocol
+*/
+
+void Receiver::CategoryProtocol::handlePackedRemoteState(const FrameHeader& header, const uint8_t* payload, int payloadLength)
+{
+	// Make the equivalent text command
+	ManagedString received(header.category);
+	received = received + string::hex(header.sequence, kMarkerForFrameKind[header.flags & kFrameKindMask]);
+	received = received + ManagedString((const char*) payload, payloadLength);
+	handleRemoteState(received);
+}
+
+void Receiver::CategoryProtocol::handleRemoteStateStale()
+{
+	// nothing to do
+}
+
+void Receiver::CategoryProtocol::handlePredictedFields(const int16_t* /* fields */, int /* fieldCount */)
+{
+	// nothing to do
+}
+
+/**	@class	Receiver::CategoryRecord
+*/
+
+//																						 123456789abcdef0
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsSyncDuration,	"\x10", " SyncDuration:  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRecoveryCount,	"\x10", " RecoveryCount: ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsDuplicateCount,	"\x10", " Duplicates:    ")
+
+/// Duplicate Window, in which a frame older than the latest sequence number is regarded as a retransmitted duplicate
+static const int kDuplicateWindow = 16;
+
+/// Initial Sync Duration in 100 milliseconds
+static const uint16_t kSyncDurationInitial	= 4;
+
+Receiver::CategoryRecord::CategoryRecord(char category, Receiver::CategoryProtocol& protocol)
+	: protocol(protocol)
+	, category(category)
+	, mSequence(0)
+	, mSyncDuration(0)
+	, mSyncNextCount(0)
+	, mStatisticsSyncDuration(ManagedString(category) + ManagedString(sStatisticsSyncDuration))
+	, mStatisticsRecoveryCount(ManagedString(category) + ManagedString(sStatisticsRecoveryCount))
+	, mStatisticsDuplicateCount(ManagedString(category) + ManagedString(sStatisticsDuplicateCount))
+	, mSnapshotLength(-1)
+	, mKeyframeRequested(false)
+	, mSnapshot(0)
+	, mLastReceivedTime(0)
+	, mMeanInterval(0)
+	, mJitter(0)
+	, mLossRate(0)
+	, mRecoveryLatency(0)
+	, mReceivedCount(0)
+	, mLostCount(0)
+	, mRssi(0)
+	, mStaleTimeout(0)
+	, mStale(false)
+	, mPredictionMode(kPredictionNone)
+	, mFieldCount(0)
+	, mPredictionHorizon(0)
+	, mFieldsUpdateCount(0)
+	, mFieldsTime(0)
+	, mFieldsInterval(0)
+	, mFields(0)
+{
+}
+
+Receiver::CategoryRecord::~CategoryRecord()
+{
+	delete[] mSnapshot;
+	delete[] mFields;
+}
+
+void Receiver::CategoryRecord::requestToSend()
+{
+	if(Receiver::global().wireFormat() != kWireFormatText) {
+		uint8_t frame[kFrameHeaderSize];
+		FrameHeader header = { category, kFrameKindRequest, 0 };
+		int frameLength = encodeFrame(frame, header, 0);
+		sendFrame(frame, frameLength);
+	}
+	else {
+		char buf[3] = { category, kMarkerRequest, 0 };
+		ManagedString s(buf);
+		radio::send(s);
+	}
+}
+
+void Receiver::CategoryRecord::handleRadioCommandReceived(ManagedString& received)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "Receiver::Record::handleRadioCommandReceived");
+
+	char marker = received.charAt(1);
+	if((marker != kMarkerResponse) && (marker != kMarkerNotification)) {
+		return;	// invalid command
+	}
+
+	uint8_t sequence = string::numberForHexString(received, 2);
+	if(!acceptSequence(sequence, marker == kMarkerResponse)) {
+		return;	// sequence number is not changed
+	}
+
+	protocol.handleRemoteState(received);
+}
+
+void Receiver::CategoryRecord::handleRadioFrameReceived(const uint8_t* frame, int frameLength)
+{
+//	debug_sendLine(EXT_KIT_DEBUG_TRACE "Receiver::Record::handleRadioFrameReceived");
+
+	FrameHeader header;
+	int payloadLength = decodeFrame(frame, frameLength, header);
+	if(payloadLength < 0) {
+		return;	// invalid frame
+	}
+
+	uint8_t kind = header.flags & kFrameKindMask;
+	if((kind != kFrameKindResponse) && (kind != kFrameKindNotification)) {
+		return;	// invalid frame
+	}
+
+	if(header.flags & kFrameFlagFragment) {
+		Receiver::global().handleFragmentReceived(*this, header, &frame[kFrameHeaderSize], payloadLength);
+		return;
+	}
+
+	const uint8_t* payload = &frame[kFrameHeaderSize];
+	bool ackRequested = header.flags & kFrameFlagAckRequested;
+	if(ackRequested && (kind == kFrameKindNotification)) {
+		int8_t distance = mSequence.value() - header.sequence;
+		if((0 <= distance) && (distance < kDuplicateWindow)) {
+			// Suppress a retransmitted duplicate, which is never applied, but ack again in case the last ack is lost
+			// A restarted transmitter announces its first sequence number with a response, which is not suppressed.
+			Statistics::incrementItem(mStatisticsDuplicateCount);
+			sendAck();
+
+			if(mStale && (distance == 0) && (0 <= mSnapshotLength) && isApplied(header, payload, payloadLength)) {
+				// Pass the latest state again, which has been stale
+				acceptSequence(header.sequence, /* asResponse */ false);
+				header.flags &= ~kFrameFlagDelta;
+				protocol.handlePackedRemoteState(header, mSnapshot, mSnapshotLength);
+			}
+			return;
+		}
+	}
+
+	if(header.flags & kFrameFlagDelta) {
+		uint8_t expected = mSequence.value() + 1;
+		if((mSnapshotLength < 0) || (header.sequence != expected) || !applyDelta(mSnapshot, mSnapshotLength, payload, payloadLength)) {
+			// Request a keyframe because of a sequence gap
+			mSnapshotLength = -1;
+			if(!mKeyframeRequested) {
+				mKeyframeRequested = true;
+				requestToSend();
+
+				// Request again from the sync timer at the initial duration until a keyframe is received
+				mSyncDuration = kSyncDurationInitial;
+				mSyncNextCount = 0;
+				Statistics::setItem(mStatisticsSyncDuration, mSyncDuration);
+			}
+			return;
+		}
+		acceptSequence(header.sequence, /* asResponse */ false);
+		if(ackRequested) {
+			sendAck();
+		}
+
+		// Pass the reconstructed full payload
+		header.flags &= ~kFrameFlagDelta;
+		protocol.handlePackedRemoteState(header, mSnapshot, mSnapshotLength);
+		return;
+	}
+
+	// A keyframe restores the snapshot even with the same sequence number, since the transmitter responds with its current one
+	bool resyncs = (mSnapshotLength < 0) || mKeyframeRequested;
+	if(!acceptSequence(header.sequence, kind == kFrameKindResponse) && !resyncs) {
+		return;	// sequence number is not changed
+	}
+	if(ackRequested) {
+		sendAck();
+	}
+
+	// Keep the keyframe as the base for the following deltas
+	if(!mSnapshot) {
+		mSnapshot = new uint8_t[kPayloadSizeMax];
+		EXT_KIT_ASSERT_OR_PANIC(mSnapshot, panic::kOutOfMemory);
+	}
+	memcpy(mSnapshot, payload, payloadLength);
+	mSnapshotLength = payloadLength;
+	mKeyframeRequested = false;
+
+	protocol.handlePackedRemoteState(header, payload, payloadLength);
+}
+
+void Receiver::CategoryRecord::handleReassembledPayload(FrameHeader& header, const uint8_t* payload, int payloadLength)
+{
+	if(!acceptSequence(header.sequence, (header.flags & kFrameKindMask) == kFrameKindResponse)) {
+		return;	// sequence number is not changed
+	}
+
+	mSnapshotLength = -1;	// a large payload is never delta encoded
+	protocol.handlePackedRemoteState(header, payload, payloadLength);
+}
+
+bool Receiver::CategoryRecord::isApplied(const FrameHeader& header, const uint8_t* payload, int payloadLength)
+{
+	if(header.flags & kFrameFlagDelta) {
+		return true;	// a delta is applied only to the snapshot for the previous sequence number
+	}
+	return (mSnapshotLength == payloadLength) && (memcmp(mSnapshot, payload, payloadLength) == 0);
+}
+
+void Receiver::CategoryRecord::sendAck()
+{
+	uint8_t frame[kFrameHeaderSize];
+	FrameHeader header = { category, kFrameKindRequest | kFrameFlagAck, mSequence.value() };
+	int frameLength = encodeFrame(frame, header, 0);
+	sendFrame(frame, frameLength);
+}
+
+void Receiver::CategoryRecord::sendLease(uint8_t duration)
+{
+	uint8_t frame[kFrameHeaderSize + 1];
+	FrameHeader header = { category, kFrameKindRequest | kFrameFlagLease, 0 };
+	int frameLength = encodeFrame(frame, header, 1);
+	frame[kFrameHeaderSize] = duration;
+	sendFrame(frame, frameLength);
+}
+
+bool Receiver::CategoryRecord::acceptSequence(uint8_t sequence, bool asResponse)
+{
+	uint8_t previous = mSequence.value();
+	bool changed = mSequence.set(sequence);
+	updateLinkQuality(previous, sequence, changed, asResponse);
+	bool wasStale = mStale;
+	mStale = false;
+	if(!changed) {
+		uint16_t tmp = mSyncDuration;
+		if(!mKeyframeRequested && (tmp < 0x8000)) {	// no backoff while a keyframe is requested
+			mSyncDuration = tmp + tmp;
+			mSyncNextCount = 0;
+			Statistics::setItem(mStatisticsSyncDuration, mSyncDuration);
+		}
+		return wasStale;	// sequence number is not changed, but the state is passed again if it has been stale
+	}
+
+	mSyncDuration = kSyncDurationInitial;
+	mSyncNextCount = 0;
+	Statistics::setItem(mStatisticsSyncDuration, mSyncDuration);
+
+	if(asResponse) {
+		Statistics::incrementItem(mStatisticsRecoveryCount);
+	//	debug_sendLine(EXT_KIT_DEBUG_EVENT "RemoteState is rocovered by a response");
+	}
+	return true;
+}
+
+void Receiver::CategoryRecord::updateLinkQuality(uint8_t previous, uint8_t sequence, bool changed, bool asResponse)
+{
+	time::SystemTime now = time::systemTime();
+	if(mReceivedCount) {
+		time::SystemTime interval = now - mLastReceivedTime;
+		if(UINT16_MAX < interval) {
+			interval = UINT16_MAX;
+		}
+
+		// Jitter as the smoothed deviation from the smoothed interval
+		int32_t deviation = (int32_t) interval - mMeanInterval;
+		mMeanInterval += deviation / 8;
+		if(deviation < 0) {
+			deviation = -deviation;
+		}
+		mJitter += ((deviation << 4) - (int32_t) mJitter) / 16;
+
+		if(changed && asResponse) {
+			mRecoveryLatency = interval;
+		}
+		else if(changed) {
+			// Loss rate from the gap of the sequence numbers
+			int8_t gap = sequence - previous - 1;
+			int32_t sample = 0;
+			if(0 < gap) {
+				mLostCount += gap;
+				sample = gap * 1000 / (gap + 1);
+			}
+			mLossRate += ((sample << 4) - (int32_t) mLossRate) / 8;
+		}
+	}
+
+	if(mReceivedCount < UINT16_MAX) {
+		mReceivedCount++;
+	}
+	mLastReceivedTime = now;
+	mRssi = radio::lastRssi();
+}
+
+void Receiver::CategoryRecord::getLinkQuality(LinkQuality& /* OUT */ quality)
+{
+	quality.lossRate = mLossRate >> 4;
+	quality.jitter = mJitter >> 4;
+	quality.rssi = mRssi;
+	quality.age = mReceivedCount ? time::systemTime() - mLastReceivedTime : UINT32_MAX;
+	quality.recoveryLatency = mRecoveryLatency;
+	quality.receivedCount = mReceivedCount;
+	quality.lostCount = mLostCount;
+}
+
+void Receiver::CategoryRecord::setStaleTimeout(uint16_t timeout)
+{
+	mStaleTimeout = timeout;
+	if(!mStaleTimeout) {
+		mStale = false;
+	}
+}
+
+void Receiver::CategoryRecord::setPrediction(int fieldCount, PredictionMode mode, uint16_t horizon)
+{
+	EXT_KIT_ASSERT((0 <= fieldCount) && (fieldCount <= UINT8_MAX));
+
+	delete[] mFields;
+	mFields = 0;
+	mFieldCount = 0;
+	mPredictionMode = kPredictionNone;
+	mFieldsUpdateCount = 0;
+	if((mode == kPredictionNone) || (fieldCount == 0)) {
+		return;
+	}
+
+	mFields = new int16_t[fieldCount * 3];
+	EXT_KIT_ASSERT_OR_PANIC(mFields, panic::kOutOfMemory);
+
+	memset(mFields, 0, fieldCount * 3 * sizeof(int16_t));
+	mFieldCount = fieldCount;
+	mPredictionMode = mode;
+	mPredictionHorizon = horizon;
+}
+
+void Receiver::CategoryRecord::updateFields(const int16_t* fields)
+{
+	if(!mFields) {
+		return;
+	}
+
+	time::SystemTime now = time::systemTime();
+	memcpy(&mFields[mFieldCount], mFields, mFieldCount * sizeof(int16_t));	// the last to the previous
+	memcpy(mFields, fields, mFieldCount * sizeof(int16_t));
+	mFieldsInterval = now - mFieldsTime;
+	mFieldsTime = now;
+	if(mFieldsUpdateCount < UINT8_MAX) {
+		mFieldsUpdateCount++;
+	}
+}
+
+void Receiver::CategoryRecord::checkStaleness()
+{
+	if(!mStaleTimeout || mStale || (mReceivedCount == 0)) {
+		return;
+	}
+
+	if(time::systemTime() - mLastReceivedTime < mStaleTimeout) {
+		return;
+	}
+
+	mStale = true;
+	protocol.handleRemoteStateStale();
+}
+
+void Receiver::CategoryRecord::predictFields()
+{
+	if(!mFields || (mFieldsUpdateCount == 0)) {
+		return;
+	}
+
+	time::SystemTime elapsed = time::systemTime() - mFieldsTime;
+	if(mPredictionHorizon < elapsed) {
+		elapsed = mPredictionHorizon;
+	}
+
+	const int16_t* last = mFields;
+	const int16_t* previous = &mFields[mFieldCount];
+	int16_t* predicted = &mFields[mFieldCount * 2];
+	for(int i = 0; i < mFieldCount; i++) {
+		int32_t value = last[i];
+		if(mPredictionMode == kPredictionLinear) {
+			if((2 <= mFieldsUpdateCount) && (0 < mFieldsInterval)) {
+				value += (int32_t) (last[i] - previous[i]) * (int32_t) elapsed / (int32_t) mFieldsInterval;
+			}
+		}
+		else if(mPredictionMode == kPredictionDecay) {
+			if(0 < mPredictionHorizon) {
+				value -= value * (int32_t) elapsed / mPredictionHorizon;
+			}
+		}
+		if(value < INT16_MIN) {
+			value = INT16_MIN;
+		}
+		else if(INT16_MAX < value) {
+			value = INT16_MAX;
+		}
+		predicted[i] = value;
+	}
+	protocol.handlePredictedFields(predicted, mFieldCount);
+}
+
+void Receiver::CategoryRecord::handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit /* unit */)
+{
+	checkStaleness();
+	predictFields();
+
+	if(mSyncDuration == 0) {
+		return;	// synchronization is not started
+	}
+
+	if(mSyncNextCount == 0) {
+		mSyncNextCount = count + mSyncDuration;
+		return;	// the next count is not set
+	}
+
+	uint32_t remainingCount = mSyncNextCount - count;
+	if(remainingCount <= (uint32_t) INT32_MAX) {
+		return;	// the next count is not reached
 	}
 
 	mSyncNextCount = count + mSyncDuration;
 	requestToSend();
 }
 
+/**	@class	Relay
+*/
+
+//																		 123456789abcdef012345
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRelayForwarded,	"\x15", "Relay Forwarded:     ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRelaySuppressed,	"\x15", "Relay Suppressed:    ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRelayDropped,		"\x15", "Relay Dropped:       ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRelayWindow,		"\x15", "Relay Window (ms):   ")
+
+/// Min Delay Window in milliseconds
+static const uint16_t kRelayDelayWindowMin		= 20;
+
+/// Max Delay Window in milliseconds
+static const uint16_t kRelayDelayWindowMax		= 320;
+
+/// Number of times heard from other relays to cancel a pending rebroadcast
+static const uint8_t kRelayHeardCountToCancel	= 2;
+
+/// Approximate on-air time of a datagram in milliseconds, which is added to the age
+static const uint16_t kRelayAirTime				= 1;
+
+Relay* Relay::sGlobal = 0;
+
+Relay& Relay::global()
+{
+	EXT_KIT_ASSERT(sGlobal);
+
+	return *sGlobal;
+}
+
+Relay::Relay()
+	: Component("Relay")
+	, mOrigin((uint16_t) microbit_serial_number())
+	, mCacheNext(0)
+	, mDelayWindow(kRelayDelayWindowMin)
+	, mForwardedCount(0)
+	, mSuppressedCount(0)
+	, mDroppedCount(0)
+{
+	memset(mCache, 0, sizeof(mCache));
+	memset(mPending, 0, sizeof(mPending));
+
+	MicroBitRadio* r = ExtKit::global().radio();
+	EXT_KIT_ASSERT(r);
+
+	EXT_KIT_ASSERT(!sGlobal);
+
+	sGlobal = this;
+}
+
+Relay::~Relay()
+{
+	if(sGlobal == this) {
+		sGlobal = 0;
+	}
+}
+
+/* Component */ void Relay::doHandleComponentAction(Action action)
+{
+	if(action == kStart) {
+		radio::prepare();
+
+		// Listen to radio datagrams to be relayed
+		radio::listen(*this);
+
+		// Listen Periodic Observer for pending rebroadcasts
+		PeriodicObserver::listen(PeriodicObserver::kUnit20ms, *this, PeriodicObserver::kPriorityLow);
+	}
+	else if(action == kStop) {
+		// Ignore Periodic Observer
+		PeriodicObserver::ignore(PeriodicObserver::kUnit20ms, *this);
+
+		// Ignore radio datagrams to be relayed
+		radio::ignore(*this);
+
+		// Discard pending rebroadcasts
+		for(int i = 0; i < kPendingCount; i++) {
+			mPending[i].envelopeLength = 0;
+		}
+	}
+
+	Component::doHandleComponentAction(action);
+}
+
+/* radio::DatagramProtocol */ void Relay::handleRadioDatagram(const uint8_t* datagram, int length)
+{
+	RelayHeader header;
+	int frameLength = decodeRelayEnvelope(datagram, length, header);
+	if(frameLength <= 0) {
+		return;	// not a relay envelope
+	}
+
+	if(header.origin == mOrigin) {
+		return;	// sent from this device
+	}
+
+	bool found;
+	int cacheIndex = lookUpDuplicateCache(header, &datagram[kRelayHeaderSize], frameLength, found);
+	if(found) {
+		DuplicateEntry& e = mCache[cacheIndex];
+		if(e.heardCount < UINT8_MAX) {
+			e.heardCount++;
+		}
+		if(e.heardCount < kRelayHeardCountToCancel) {
+			return;
+		}
+
+		// Cancel the pending rebroadcast because another relay has already rebroadcast it
+		for(int i = 0; i < kPendingCount; i++) {
+			PendingEntry& p = mPending[i];
+			if(p.envelopeLength && (p.cacheIndex == cacheIndex)) {
+				p.envelopeLength = 0;
+				Statistics::setItem(sStatisticsRelaySuppressed, ++mSuppressedCount);
+				widenDelayWindow();
+			}
+		}
+		return;
+	}
+
+	if(header.ttl <= 1) {
+		Statistics::setItem(sStatisticsRelayDropped, ++mDroppedCount);
+		return;	// the TTL is expired
+	}
+
+	for(int i = 0; i < kPendingCount; i++) {
+		PendingEntry& p = mPending[i];
+		if(p.envelopeLength) {
+			continue;
+		}
+
+		memcpy(p.envelope, datagram, length);
+		p.envelopeLength = length;
+		p.cacheIndex = cacheIndex;
+		p.receivedTime = time::systemTime();
+		p.dueTime = p.receivedTime + microbit_random(mDelayWindow);
+		return;
+	}
+
+	// No pending entry available
+	Statistics::setItem(sStatisticsRelayDropped, ++mDroppedCount);
+	widenDelayWindow();
+}
+
+/* PeriodicObserver::HandlerProtocol */ void Relay::handlePeriodicEvent(uint32_t /* count */, PeriodicObserver::PeriodUnit /* unit */)
+{
+	for(int i = 0; i < kPendingCount; i++) {
+		PendingEntry& p = mPending[i];
+		if(!p.envelopeLength || !time::isElapsed(p.dueTime)) {
+			continue;
+		}
+
+		// Rebroadcast with the TTL decremented
+		RelayHeader header;
+		int frameLength = decodeRelayEnvelope(p.envelope, p.envelopeLength, header);
+		EXT_KIT_ASSERT(0 < frameLength);
+
+		uint32_t age = header.age + (time::systemTime() - p.receivedTime) + kRelayAirTime;
+		header.ttl--;
+		header.hops = (header.hops < kRelayTtlMax) ? header.hops + 1 : kRelayTtlMax;
+		header.age = (age < UINT16_MAX) ? age : UINT16_MAX;
+
+		uint8_t envelope[kFrameSizeMax];
+		int envelopeLength = encodeRelayEnvelope(envelope, header, &p.envelope[kRelayHeaderSize], frameLength);
+		transmit(envelope, envelopeLength);
+		p.envelopeLength = 0;
+		Statistics::setItem(sStatisticsRelayForwarded, ++mForwardedCount);
+
+		// Narrow the delay window after a quiet forward
+		if(kRelayDelayWindowMin < mDelayWindow) {
+			mDelayWindow /= 2;
+			if(mDelayWindow < kRelayDelayWindowMin) {
+				mDelayWindow = kRelayDelayWindowMin;
+			}
+			Statistics::setItem(sStatisticsRelayWindow, mDelayWindow);
+		}
+	}
+}
+
+int /* cacheIndex */ Relay::lookUpDuplicateCache(const RelayHeader& header, const uint8_t* frame, int frameLength, bool& /* OUT */ found)
+{
+	char category = frame[0];
+	uint8_t sequence = (kFrameHeaderSize <= frameLength) ? frame[2] : 0;
+	uint8_t checkSum = relayCheckSum(frame, frameLength);
+
+	for(int i = 0; i < kDuplicateCacheSize; i++) {
+		DuplicateEntry& e = mCache[i];
+		if(e.heardCount && (e.origin == header.origin) && (e.category == category) && (e.sequence == sequence) && (e.checkSum == checkSum)) {
+			found = true;
+			return i;
+		}
+	}
+
+	// Replace the oldest entry
+	int cacheIndex = mCacheNext;
+	mCacheNext = (mCacheNext + 1) % kDuplicateCacheSize;
+
+	// Discard the pending rebroadcast for the replaced entry
+	for(int i = 0; i < kPendingCount; i++) {
+		if(mPending[i].envelopeLength && (mPending[i].cacheIndex == cacheIndex)) {
+			mPending[i].envelopeLength = 0;
+		}
+	}
+
+	DuplicateEntry& e = mCache[cacheIndex];
+	e.origin = header.origin;
+	e.category = category;
+	e.sequence = sequence;
+	e.checkSum = checkSum;
+	e.heardCount = 1;
+	found = false;
+	return cacheIndex;
+}
+
+void Relay::widenDelayWindow()
+{
+	if(mDelayWindow < kRelayDelayWindowMax) {
+		mDelayWindow *= 2;
+		if(kRelayDelayWindowMax < mDelayWindow) {
+			mDelayWindow = kRelayDelayWindowMax;
+		}
+		Statistics::setItem(sStatisticsRelayWindow, mDelayWindow);
+	}
+}
+
+/**	@class	LoopbackBenchmark
+*/
+
+/// Timeout in milliseconds for an update over the loopback transport
+static const time::SystemTime kBenchmarkUpdateTimeout	= 1000;
+
+/// Duration in milliseconds while every datagram is lost
+static const time::SystemTime kBenchmarkLossDuration	= 100;
+
+/// Timeout in milliseconds for the recovery after loss
+static const time::SystemTime kBenchmarkRecoveryTimeout	= 10000;
+
+/// Marker character for the value in the text command
+static const char kBenchmarkMarkerValue = '#';
+
+/// Loopback Benchmark, which is the category protocol for both Transmitter and Receiver
+class LoopbackBenchmark : public Transmitter::CategoryProtocol, public Receiver::CategoryProtocol
+{
+public:
+	/// Constructor
+	LoopbackBenchmark()
+		: sentValue(0)
+		, receivedValue(0)
+	{
+	}
+
+	/// Inherited
+	/* Transmitter::CategoryProtocol */ ManagedString remoteState()
+	{
+		return string::hex(sentValue, kBenchmarkMarkerValue);
+	}
+
+	/// Inherited
+	/* Transmitter::CategoryProtocol */ int /* payloadLength */ packRemoteState(uint8_t* /* OUT */ payload, int /* payloadSizeMax */)
+	{
+		payload[0] = sentValue & 0xff;
+		payload[1] = sentValue >> 8;
+		return 2;
+	}
+
+	/// Inherited
+	/* Receiver::CategoryProtocol */ void handleRemoteState(ManagedString& received)
+	{
+		int16_t i = string::seekTo(kBenchmarkMarkerValue, received);
+		if(i < 0) {
+			return;
+		}
+		receivedValue = string::numberForHexString(received, i);
+	}
+
+	/// Inherited
+	/* Receiver::CategoryProtocol */ void handlePackedRemoteState(const FrameHeader& /* header */, const uint8_t* payload, int payloadLength)
+	{
+		if(payloadLength < 2) {
+			return;
+		}
+		receivedValue = payload[0] | (payload[1] << 8);
+	}
+
+	/// Wait until the value sent is received. Returns false if timed out.
+	bool waitForValue(time::SystemTime timeout)
+	{
+		time::SystemTime target = time::systemTime() + timeout;
+		while(receivedValue != sentValue) {
+			if(time::isElapsed(target)) {
+				return false;
+			}
+			time::sleep(1);
+		}
+		return true;
+	}
+
+	/// Value sent
+	uint16_t	sentValue;
+
+	/// Value received
+	uint16_t	receivedValue;
+
+};	// LoopbackBenchmark
+
+void debug_sendLoopbackBenchmark(char category, int changeCount)
+{
+	EXT_KIT_ASSERT(0 < changeCount);
+
+	radio::LoopbackTransport& loopback = radio::LoopbackTransport::global();
+	Transmitter& transmitter = Transmitter::global();
+	Receiver& receiver = Receiver::global();
+
+	LoopbackBenchmark benchmark;
+	transmitter.listen(category, benchmark);
+	receiver.listen(category, benchmark);
+
+	// Update latency and datagrams per state change
+	uint16_t sentCount = loopback.sentCount();
+	time::MicroTime totalLatency = 0;
+	int deliveredCount = 0;
+	for(int n = 0; n < changeCount; n++) {
+		benchmark.sentValue++;
+		time::MicroTime start = time::microTime();
+		transmitter.requestToSend(category);
+		if(benchmark.waitForValue(kBenchmarkUpdateTimeout)) {
+			totalLatency += time::microTime() - start;
+			deliveredCount++;
+		}
+	}
+	uint16_t datagramCount = loopback.sentCount() - sentCount;
+
+	// Recovery time after loss: every datagram for a state change is lost, and the Receiver requests it again after its sync duration
+	uint16_t lossRate = loopback.lossRate();
+	loopback.setLossRate(1000);
+	benchmark.sentValue++;
+	transmitter.requestToSend(category);
+	time::sleep(kBenchmarkLossDuration);
+	loopback.setLossRate(lossRate);
+	time::MicroTime start = time::microTime();
+	bool recovered = benchmark.waitForValue(kBenchmarkRecoveryTimeout);
+	time::MicroTime recoveryTime = time::microTime() - start + kBenchmarkLossDuration * 1000;
+
+	transmitter.ignore(category);
+	receiver.ignore(category);
+
+	debug_sendLine(EXT_KIT_DEBUG_INFO "remoteState loopback benchmark: changes = ", ManagedString(changeCount).toCharArray());
+	debug_sendLine(EXT_KIT_DEBUG_INFO "- delivered changes: ", ManagedString(deliveredCount).toCharArray());
+	if(0 < deliveredCount) {
+		debug_sendLine(EXT_KIT_DEBUG_INFO "- update latency avg [us]: ", ManagedString((int) (totalLatency / deliveredCount)).toCharArray());
+	}
+	debug_sendLine(EXT_KIT_DEBUG_INFO "- datagrams per change x100: ", ManagedString(datagramCount * 100 / changeCount).toCharArray());
+	if(recovered) {
+		debug_sendLine(EXT_KIT_DEBUG_INFO "- recovery after loss [ms]: ", ManagedString((int) (recoveryTime / 1000)).toCharArray());
+	}
+	else {
+		debug_sendLine(EXT_KIT_DEBUG_INFO "- recovery after loss: timed out");
+	}
+}
+
 }	// remoteState
 }	// microbit_dal_ext_kit
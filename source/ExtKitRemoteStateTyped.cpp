@@ -0,0 +1,137 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Typed Remote State categories
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#include "ExtKitRemoteStateTyped.h"	// self
+#include "ExtKit.h"
+
+namespace microbit_dal_ext_kit {
+namespace remoteState {
+namespace typed {
+
+/// Hex digits
+static const char kHexDigits[] = "0123456789abcdef";
+
+static int hexDigitValue(char c)
+{
+	if(('0' <= c) && (c <= '9')) {
+		return c - '0';
+	}
+	if(('a' <= c) && (c <= 'f')) {
+		return c - 'a' + 10;
+	}
+	if(('A' <= c) && (c <= 'F')) {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+int /* size */ packedSize(const TypedField* fields, int fieldCount)
+{
+	int size = 0;
+	for(int i = 0; i < fieldCount; i++) {
+		size += fields[i].size;
+	}
+	return size;
+}
+
+int /* payloadLength */ pack(const void* state, const TypedField* fields, int fieldCount, uint8_t* /* OUT */ payload, int payloadSizeMax)
+{
+	EXT_KIT_ASSERT(fieldCount <= kTypedFieldCountMax);
+
+	const uint8_t* s = static_cast<const uint8_t*>(state);
+	int length = 0;
+	for(int i = 0; i < fieldCount; i++) {
+		const TypedField& f = fields[i];
+		if(payloadSizeMax < length + f.size) {
+			return 0;	// too small
+		}
+		memcpy(&payload[length], &s[f.offset], f.size);
+		length += f.size;
+	}
+	return length;
+}
+
+uint32_t /* changedMask */ unpack(void* /* IN OUT */ state, const TypedField* fields, int fieldCount, const uint8_t* payload, int payloadLength)
+{
+	EXT_KIT_ASSERT(fieldCount <= kTypedFieldCountMax);
+
+	if(packedSize(fields, fieldCount) != payloadLength) {
+		return 0;	// not matched
+	}
+
+	uint8_t* s = static_cast<uint8_t*>(state);
+	uint32_t changedMask = 0;
+	for(int i = 0; i < fieldCount; i++) {
+		const TypedField& f = fields[i];
+		if(memcmp(&s[f.offset], payload, f.size) != 0) {
+			memcpy(&s[f.offset], payload, f.size);
+			changedMask |= (uint32_t) 1 << i;
+		}
+		payload += f.size;
+	}
+	return changedMask;
+}
+
+uint32_t /* changedMask */ compare(const void* state, const void* newState, const TypedField* fields, int fieldCount)
+{
+	EXT_KIT_ASSERT(fieldCount <= kTypedFieldCountMax);
+
+	const uint8_t* s = static_cast<const uint8_t*>(state);
+	const uint8_t* t = static_cast<const uint8_t*>(newState);
+	uint32_t changedMask = 0;
+	for(int i = 0; i < fieldCount; i++) {
+		const TypedField& f = fields[i];
+		if(memcmp(&s[f.offset], &t[f.offset], f.size) != 0) {
+			changedMask |= (uint32_t) 1 << i;
+		}
+	}
+	return changedMask;
+}
+
+ManagedString encodeText(const uint8_t* payload, int payloadLength)
+{
+	char buf[1 + kPayloadSizeMax * 2 + 1];
+	EXT_KIT_ASSERT(payloadLength <= kPayloadSizeMax);
+
+	char* p = buf;
+	*p++ = kMarkerTypedPayload;
+	for(int i = 0; i < payloadLength; i++) {
+		*p++ = kHexDigits[payload[i] >> 4];
+		*p++ = kHexDigits[payload[i] & 0xf];
+	}
+	*p = 0;
+	return ManagedString(buf);
+}
+
+int /* payloadLength */ decodeText(const ManagedString& received, uint8_t* /* OUT */ payload, int payloadSizeMax)
+{
+	int16_t i = string::seekTo(kMarkerTypedPayload, received);
+	if(i < 0) {
+		return 0;	// no payload
+	}
+
+	const char* s = received.toCharArray();
+	int16_t length = received.length();
+	int payloadLength = 0;
+	while((i + 1 < length) && (payloadLength < payloadSizeMax)) {
+		int high = hexDigitValue(s[i++]);
+		int low = hexDigitValue(s[i++]);
+		if((high < 0) || (low < 0)) {
+			break;
+		}
+		payload[payloadLength++] = (high << 4) | low;
+	}
+	return payloadLength;
+}
+
+}	// typed
+}	// remoteState
+}	// microbit_dal_ext_kit
@@ -18,11 +18,49 @@ namespace serial {
 //																	 123456789abcdef012345
 EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sSendError1,	"\x15", "Serial Send Error 1: ")
 EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sSendError2,	"\x15", "Serial Send Error 2: ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sTxOverflow,	"\x15", "Serial Tx Overflow:  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sTxQueueMax,	"\x15", "Serial Tx Queue Max: ")
 
+/// Whether the TX queue is enabled or not
+static const bool kTxQueueEnabled = (0 < EXT_KIT_CONFIG_VALUE(SERIAL_TXQUEUE));
+
+/// TX Queue Size in bytes
+static const size_t kTxQueueSize = kTxQueueEnabled ? EXT_KIT_CONFIG_VALUE(SERIAL_TXQUEUE) : 1;
+
+/// Size of the buffer for a line sent at once
+static const size_t kLineSize = 128;
+
+/// Event value of `MICROBIT_ID_NOTIFY` for waking up the drain fiber
+static const uint16_t kTxQueueNotifyValue = 0x5354;
+
+/// TX Queue as a ring buffer
+static char		sTxQueue[kTxQueueSize];
+
+/// Index of the first byte queued
+static size_t	sTxHead = 0;
+
+/// Number of bytes queued
+static size_t	sTxLength = 0;
+
+/// Max number of bytes queued
+static size_t	sTxLengthMax = 0;
+
+/// Number of sends dropped because of the queue full
+static uint16_t	sTxOverflowCount = 0;
+
+/// Whether a chunk of the queue is being sent or not
+static bool		sTxDraining = false;
+
+/// Whether the drain fiber is created or not
+static bool		sTxDrainFiberCreated = false;
+
+static bool isTxQueueAvailable();
+static void sendNow(const uint8_t* buffer, size_t length);
+static void drainTxQueue();
+static void sendTxQueueChunk();
 static void checkSendError(int ret);
 static void dumpHexBlock(const uint8_t* buffer, size_t length);
 static void dumpHexLine(const uint8_t* buffer, size_t length);
-static void dumpHexByte(uint8_t byte);
 
 void initializeRx()
 {
@@ -59,7 +97,8 @@ void sendChar(char c)
 
 void send(int i)
 {
-	ManagedString s(i);
+	char s[12];	// max: sign + 10 digits + NUL
+	string::format(s, sizeof(s), "%d", i);
 	send(s);
 }
 
@@ -69,15 +108,35 @@ void send(const char* s)
 		return;
 	}
 
+	if(isTxQueueAvailable()) {
+		sendAll(&s, 1);
+		return;
+	}
+
 	size_t length = strlen(s);
 	if(length <= 0) {
 		return;
 	}
 
+	sendNow((const uint8_t*) s, length);
+}
+
+void send(const ManagedString& s)
+{
+	const char* p = s.toCharArray();
+	if(!*p) {
+		return;
+	}
+
+	if(isTxQueueAvailable()) {
+		sendAll(&p, 1);
+		return;
+	}
+
 	MicroBitSerial& serial = ExtKit::global().serial();
 	int ret;
 	while(true) {
-		ret = serial.send((uint8_t *) s, length);
+		ret = serial.send(s);
 		if(ret != MICROBIT_SERIAL_IN_USE) {
 			break;
 		}
@@ -86,17 +145,115 @@ void send(const char* s)
 	checkSendError(ret);
 }
 
-void send(const ManagedString& s)
+bool sendAll(const char* const* strings, int count)
 {
-	const char* p = s.toCharArray();
-	if(!*p) {
+	size_t total = 0;
+	for(int i = 0; i < count; i++) {
+		if(strings[i]) {
+			total += strlen(strings[i]);
+		}
+	}
+	if(!total) {
+		return true;
+	}
+
+	if(!isTxQueueAvailable() || (kTxQueueSize < total)) {
+		// Send the strings after the queued ones synchronously, since they never fit in the queue
+		flush();
+
+		// Send the strings at once if they fit in a line
+		char line[kLineSize];
+		if(total < sizeof(line)) {
+			char* p = line;
+			for(int i = 0; i < count; i++) {
+				for(const char* s = strings[i]; s && *s; s++) {
+					*p++ = *s;
+				}
+			}
+			sendNow((const uint8_t*) line, total);
+		}
+		else {
+			for(int i = 0; i < count; i++) {
+				if(strings[i] && *strings[i]) {
+					sendNow((const uint8_t*) strings[i], strlen(strings[i]));
+				}
+			}
+		}
+		return true;
+	}
+	if(kTxQueueSize - sTxLength < total) {
+		Statistics::setItem(sTxOverflow, ++sTxOverflowCount);	// drop the whole strings to keep the queued lines intact
+		return false;
+	}
+
+	// Copy the strings into the ring buffer. No other fiber runs until this function returns.
+	size_t tail = (sTxHead + sTxLength) % kTxQueueSize;
+	for(int i = 0; i < count; i++) {
+		for(const char* p = strings[i]; p && *p; p++) {
+			sTxQueue[tail] = *p;
+			tail = (tail + 1 == kTxQueueSize) ? 0 : tail + 1;
+		}
+	}
+	sTxLength += total;
+	if(sTxLengthMax < sTxLength) {
+		sTxLengthMax = sTxLength;
+		Statistics::setItem(sTxQueueMax, sTxLengthMax);
+	}
+
+	// Wake up the drain fiber
+	if(!sTxDrainFiberCreated) {
+		sTxDrainFiberCreated = true;
+		create_fiber(drainTxQueue);
+	}
+	else {
+		MicroBitEvent(MICROBIT_ID_NOTIFY_ONE, kTxQueueNotifyValue);
+	}
+	return true;
+}
+
+void flush()
+{
+	while(0 < sTxLength) {
+		if(sTxDraining) {
+			time::sleep(0 /* milliseconds */);	// wait for the chunk being sent by the drain fiber
+		}
+		else {
+			sendTxQueueChunk();
+		}
+	}
+}
+
+void sendBinary(const uint8_t* buffer, size_t length)
+{
+	if(!length) {
+		return;
+	}
+
+	flush();
+	sendNow(buffer, length);
+}
+
+void sendUnqueued(const char* s)
+{
+	if(!s || !*s) {
 		return;
 	}
 
+	flush();
+	sendNow((const uint8_t*) s, strlen(s));
+}
+
+bool isTxQueueAvailable()
+{
+	return kTxQueueEnabled && fiber_scheduler_running();
+}
+
+void sendNow(const uint8_t* buffer, size_t length)
+{
 	MicroBitSerial& serial = ExtKit::global().serial();
 	int ret;
 	while(true) {
-		ret = serial.send(s);
+		ret = serial.send((uint8_t *) buffer, length);
 		if(ret != MICROBIT_SERIAL_IN_USE) {
 			break;
 		}
@@ -105,6 +262,31 @@ void send(const ManagedString& s)
 	checkSendError(ret);
 }
 
+void drainTxQueue()
+{
+	while(true) {
+		if(!sTxLength || sTxDraining) {
+			fiber_wait_for_event(MICROBIT_ID_NOTIFY, kTxQueueNotifyValue);
+			continue;
+		}
+		sendTxQueueChunk();
+	}
+}
+
+void sendTxQueueChunk()
+{
+	// Send the bytes up to the end of the ring buffer directly from it. The bytes stay queued until sent, so that the senders do not overwrite them.
+	sTxDraining = true;
+	size_t length = kTxQueueSize - sTxHead;
+	if(sTxLength < length) {
+		length = sTxLength;
+	}
+	sendNow((const uint8_t*) &sTxQueue[sTxHead], length);
+	sTxHead = (sTxHead + length) % kTxQueueSize;
+	sTxLength -= length;
+	sTxDraining = false;
+}
+
 void checkSendError(int ret)
 {
 	if(0 < ret) {
@@ -161,30 +343,14 @@ void dumpHexBlock(const uint8_t* buffer, size_t length)
 
 void dumpHexLine(const uint8_t* buffer, size_t length)
 {
+	char line[80];	// max: 4 address bytes * 3 + ':' + 4 groups * (1 + 4 bytes * 3) + "\r\n" + NUL = 66
 	const uint8_t* addr = (const uint8_t*) &buffer;
-	for(int i = 0; i < 4; i++) {
-		dumpHexByte(*addr++);
-	}
-	send(":");
+	int n = string::format(line, sizeof(line), " %02x %02x %02x %02x:", addr[0], addr[1], addr[2], addr[3]);
 	for(size_t i = 0; i < length; i++) {
-		if((i & 0x3) == 0) {
-			send(" ");
-		}
-		dumpHexByte(*buffer++);
+		n += string::format(&line[n], sizeof(line) - n, ((i & 0x3) == 0) ? "  %02x" : " %02x", *buffer++);
 	}
-	send("\r\n");
-}
-
-void dumpHexByte(uint8_t byte)
-{
-	static char buf[4];
-	uint8_t hi = byte >> 4;
-	uint8_t lo = byte & 0xF;
-	buf[0] = ' ';
-	buf[1] = (10 <= hi) ? hi - 10 + 'a' : hi + '0';
-	buf[2] = (10 <= lo) ? lo - 10 + 'a' : lo + '0';
-	buf[3] = 0;
-	send(buf);
+	string::format(&line[n], sizeof(line) - n, "\r\n");
+	send(line);
 }
 
 }	// serial
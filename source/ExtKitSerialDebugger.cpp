@@ -269,6 +269,10 @@ clear_buffer:
 				Statistics::debug_sendItems();
 				return true;	// consumed
 			}
+			else if((c2 == 'l') || (c2 == 'L')) {	// Show Link quality
+				remoteState::Receiver::debug_sendLinkQuality();
+				return true;	// consumed
+			}
 		}
 		else if((c1 == 'e') || (c1 == 'E')) {
 			if((c2 == 'f') || (c2 == 'F')) {		// Emulate Failed assertion
@@ -293,6 +297,12 @@ clear_buffer:
  				return true;	// consumed
 			}
 		}
+		else if((c1 == 't') || (c1 == 'T')) {
+			if((c2 == 'r') || (c2 == 'R')) {	// send Trace Records
+				trace::sendRecords();
+				return true;	// consumed
+			}
+		}
 	}
 	return false;	// not consumed
 }
@@ -327,10 +337,12 @@ clear_buffer:
 		":sc     Show Configuration",
 		":sd     Show Device information",
 		":ss     Show Statistics",
+		":sl     Show Link quality of remoteState",
 		":ef     Emulate Failed assertion",
 		":ep     Emulate Panic (Unexpected Error)",
 		":id     Identify the Device",
 		":rd     Reset the Device",
+		":tr     send Trace Records in binary",
 		":q      Quit the debugger",
 		0	// END OF TABLE
 	};
@@ -409,6 +421,8 @@ void SerialDebugger::debug_sendLines(const char* const * lineArray /* terminated
 
 	debug_sendLine("- CONFIG SERIAL_RXBUF: ", ManagedString(EXT_KIT_CONFIG_VALUE(SERIAL_RXBUF)).toCharArray(), false);
 	debug_sendLine("- CONFIG SERIAL_TXBUF: ", ManagedString(EXT_KIT_CONFIG_VALUE(SERIAL_TXBUF)).toCharArray(), false);
+	debug_sendLine("- CONFIG SERIAL_TXQUEUE: ", ManagedString(EXT_KIT_CONFIG_VALUE(SERIAL_TXQUEUE)).toCharArray(), false);
+	debug_sendLine("- CONFIG TRACE_BUFFER: ", ManagedString(EXT_KIT_CONFIG_VALUE(TRACE_BUFFER)).toCharArray(), false);
 
 //	debug_sendLine("gSerial.getRxBufferSize(): ", ManagedString(gSerial.getRxBufferSize()).toCharArray(), false);
 //	debug_sendLine("gSerial.getTxBufferSize(): ", ManagedString(gSerial.getTxBufferSize()).toCharArray(), false);
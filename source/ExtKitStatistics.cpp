@@ -55,7 +55,9 @@ void Statistics::debug_sendItems()
 		uint16_t count = r->count;
 		r->count = 0;
 		r->total += count;
-		debug_sendLine(EXT_KIT_DEBUG_STATISTICS, r->title.toCharArray(), "\t0x", string::hex(count).toCharArray());
+		char countString[12];	// max: "\t0x" + 4 digits + NUL
+		string::format(countString, sizeof(countString), "\t0x%x", count);
+		debug_sendLine(EXT_KIT_DEBUG_STATISTICS, r->title.toCharArray(), countString);
 		// incrementItem() may be called inside this debug_sendLine() call.
 	}
 }
@@ -15,6 +15,8 @@
 namespace microbit_dal_ext_kit {
 namespace string {
 
+static int formatNumber(char* /* OUT */ digits, uint32_t number, uint32_t base, char hexBase);
+
 int16_t seekTo(char c, const ManagedString& s, int16_t start)	// returns MICROBIT_NO_DATA or the next position on s
 {
 	ManagedString t(s);
@@ -136,5 +138,132 @@ ManagedString hex(uint32_t number, char prefix)
 	}
 }
 
+int format(char* /* OUT */ buffer, size_t size, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	int length = formatV(buffer, size, fmt, args);
+	va_end(args);
+	return length;
+}
+
+int formatV(char* /* OUT */ buffer, size_t size, const char* fmt, va_list args)
+{
+	if(!size) {
+		return 0;
+	}
+
+	char* p = buffer;
+	char* end = buffer + size - 1;	// reserved for NUL
+	while(*fmt && (p < end)) {
+		char c = *fmt++;
+		if(c != '%') {
+			*p++ = c;
+			continue;
+		}
+
+		// Flags and width
+		bool leftJustified = false;
+		bool zeroPadded = false;
+		for(;; fmt++) {
+			if(*fmt == '-') {
+				leftJustified = true;
+			}
+			else if(*fmt == '0') {
+				zeroPadded = true;
+			}
+			else {
+				break;
+			}
+		}
+		int width = 0;
+		while(('0' <= *fmt) && (*fmt <= '9')) {
+			width = width * 10 + (*fmt++ - '0');
+		}
+
+		// Conversion
+		char digits[11];	// max: 10 decimal digits
+		const char* s = digits;
+		int length = 0;
+		char sign = 0;
+		c = *fmt;
+		if(c) {
+			fmt++;
+		}
+		switch(c) {
+		case 'd': {
+			int32_t number = va_arg(args, int);
+			if(number < 0) {
+				sign = '-';
+			}
+			length = formatNumber(digits, (number < 0) ? 0 - (uint32_t) number : (uint32_t) number, 10, 0);
+			break;
+		}
+		case 'u':
+			length = formatNumber(digits, va_arg(args, unsigned int), 10, 0);
+			break;
+		case 'x':
+			length = formatNumber(digits, va_arg(args, unsigned int), 16, 'a');
+			break;
+		case 'X':
+			length = formatNumber(digits, va_arg(args, unsigned int), 16, 'A');
+			break;
+		case 'c':
+			digits[0] = (char) va_arg(args, int);
+			length = 1;
+			break;
+		case 's':
+			s = va_arg(args, const char*);
+			if(!s) {
+				s = "(null)";
+			}
+			length = strlen(s);
+			break;
+		default:	// including '%' and an incomplete conversion at the end
+			digits[0] = c ? c : '%';
+			length = 1;
+			break;
+		}
+
+		// Output with padding
+		int padding = width - length - (sign ? 1 : 0);
+		if(sign && zeroPadded && (p < end)) {
+			*p++ = sign;
+		}
+		for(; !leftJustified && (0 < padding) && (p < end); padding--) {
+			*p++ = zeroPadded ? '0' : ' ';
+		}
+		if(sign && !zeroPadded && (p < end)) {
+			*p++ = sign;
+		}
+		for(int i = 0; (i < length) && (p < end); i++) {
+			*p++ = s[i];
+		}
+		for(; leftJustified && (0 < padding) && (p < end); padding--) {
+			*p++ = ' ';
+		}
+	}
+	*p = 0;
+	return p - buffer;
+}
+
+int formatNumber(char* /* OUT */ digits, uint32_t number, uint32_t base, char hexBase)
+{
+	// Fill the digits from the least significant one, then reverse them
+	int length = 0;
+	do {
+		uint8_t digit = number % base;
+		digits[length++] = (digit < 10) ? digit + '0' : digit - 10 + hexBase;
+		number /= base;
+	} while(number);
+
+	for(int i = 0, j = length - 1; i < j; i++, j--) {
+		char c = digits[i];
+		digits[i] = digits[j];
+		digits[j] = c;
+	}
+	return length;
+}
+
 }	// string
 }	// microbit_dal_ext_kit
@@ -26,6 +26,11 @@ LongSystemTime /* milliseconds */ longSystemTime()
 	return system_timer_current_time();
 }
 
+MicroTime /* microseconds */ microTime()
+{
+	return us_ticker_read();
+}
+
 SystemTime durationFor(SystemTime target)
 {
 	target -= systemTime();
@@ -48,12 +53,66 @@ bool isElapsed(LongSystemTime target)
 	return durationFor(target) == 0;
 }
 
+/// System Time when the Network Time estimate is set
+static SystemTime	sNetworkTimeReference = 0;
+
+/// Offset of Network Time in milliseconds at the reference
+static int32_t		sNetworkTimeOffset = 0;
+
+/// Drift of Network Time in ppm
+static int32_t		sNetworkTimeDrift = 0;
+
+/// Offset of Network Time in milliseconds at a System Time
+static int32_t networkTimeOffsetAt(SystemTime t)
+{
+	int64_t elapsed = (int32_t) (t - sNetworkTimeReference);
+	return sNetworkTimeOffset + (int32_t) (elapsed * sNetworkTimeDrift / 1000000);
+}
+
+NetworkTime /* milliseconds */ networkTime()
+{
+	SystemTime t = systemTime();
+	return t + networkTimeOffsetAt(t);
+}
+
+SystemTime systemTimeForNetworkTime(NetworkTime target)
+{
+	// The offset hardly changes between now and the target, so evaluate it at the target roughly
+	SystemTime t = target - sNetworkTimeOffset;
+	return target - networkTimeOffsetAt(t);
+}
+
+SystemTime durationForNetworkTime(NetworkTime target)
+{
+	return durationFor(systemTimeForNetworkTime(target));
+}
+
+bool isNetworkTimeElapsed(NetworkTime target)
+{
+	return durationForNetworkTime(target) == 0;
+}
+
+void setNetworkTimeEstimate(SystemTime reference, int32_t offset, int32_t drift)
+{
+	sNetworkTimeReference = reference;
+	sNetworkTimeOffset = offset;
+	sNetworkTimeDrift = drift;
+}
+
 void sleep(uint32_t milliseconds)
 {
 	//	Do the same as MicroBit::sleep().
 	fiber_sleep(milliseconds);
 }
 
+void sleepUntilNetworkTime(NetworkTime target)
+{
+	SystemTime duration = durationForNetworkTime(target);
+	if(0 < duration) {
+		sleep(duration);
+	}
+}
+
 void sleep()
 {
 	// release the fiber, and enter the scheduler indefinitely
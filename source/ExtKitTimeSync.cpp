@@ -0,0 +1,248 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Time Sync component
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#include "ExtKitTimeSync.h"	// self
+#include "ExtKit.h"
+
+namespace microbit_dal_ext_kit {
+
+/**	@class	TimeSync
+*/
+
+//																		 123456789abcdef012345
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsRoundTrip,	"\x15", "Time Sync RTT (ms):  ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsAccuracy,	"\x15", "Time Sync Error (ms):")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sStatisticsDrift,		"\x15", "Time Sync Drift ppm: ")
+
+/// Request Size
+static const int kRequestSize		= 7;
+
+/// Response Size
+static const int kResponseSize		= 15;
+
+/// Request interval in 100 milliseconds until the samples are filled
+static const uint32_t kRequestIntervalFast	= 10;
+
+/// Request interval in 100 milliseconds after the samples are filled
+static const uint32_t kRequestIntervalSlow	= 50;
+
+/// Max Round Trip Time in milliseconds for a valid sample
+static const uint16_t kRoundTripMax	= 200;
+
+/// Min interval in milliseconds between the samples for a drift estimate
+static const time::SystemTime kDriftIntervalMin	= 60000;
+
+/// Max Drift in ppm
+static const int32_t kDriftMax		= 500;
+
+static void putLong(uint8_t* p, uint32_t value)
+{
+	p[0] = value & 0xff;
+	p[1] = (value >> 8) & 0xff;
+	p[2] = (value >> 16) & 0xff;
+	p[3] = value >> 24;
+}
+
+static uint32_t getLong(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+TimeSync* TimeSync::sGlobal = 0;
+
+TimeSync& TimeSync::global()
+{
+	EXT_KIT_ASSERT(sGlobal);
+
+	return *sGlobal;
+}
+
+TimeSync::TimeSync(Role role)
+	: Component("TimeSync")
+	, mRole(role)
+	, mSequence(0)
+	, mNextCount(0)
+	, mSampleCount(0)
+	, mSampleNext(0)
+	, mAccuracy(0)
+	, mDrift(0)
+	, mDriftReferenceTime(0)
+	, mDriftReferenceOffset(0)
+{
+	memset(mSamples, 0, sizeof(mSamples));
+
+	EXT_KIT_ASSERT(!sGlobal);
+
+	sGlobal = this;
+}
+
+TimeSync::~TimeSync()
+{
+	if(sGlobal == this) {
+		sGlobal = 0;
+	}
+}
+
+/* Component */ void TimeSync::doHandleComponentAction(Action action)
+{
+	if(action == kStart) {
+		radio::prepare();
+
+		// Listen to sync datagrams
+		radio::listen(*this);
+
+		// Listen Periodic Observer for sync requests
+		if(mRole == kRoleSlave) {
+			PeriodicObserver::listen(PeriodicObserver::kUnit100ms, *this, PeriodicObserver::kPriorityLow);
+		}
+	}
+	else if(action == kStop) {
+		// Ignore Periodic Observer
+		if(mRole == kRoleSlave) {
+			PeriodicObserver::ignore(PeriodicObserver::kUnit100ms, *this);
+		}
+
+		// Ignore sync datagrams
+		radio::ignore(*this);
+	}
+
+	Component::doHandleComponentAction(action);
+}
+
+TimeSync::Role TimeSync::role()
+{
+	return mRole;
+}
+
+bool TimeSync::isSynchronized()
+{
+	return (mRole == kRoleMaster) || (0 < mSampleCount);
+}
+
+uint16_t TimeSync::accuracy()
+{
+	return mAccuracy;
+}
+
+/* radio::DatagramProtocol */ void TimeSync::handleRadioDatagram(const uint8_t* datagram, int length)
+{
+	if((length < kRequestSize) || (datagram[0] != 0)) {
+		return;
+	}
+
+	if((datagram[1] == kFlagsRequest) && (mRole == kRoleMaster)) {
+		handleRequest(datagram, length, time::networkTime());
+	}
+	else if((datagram[1] == kFlagsResponse) && (mRole == kRoleSlave)) {
+		handleResponse(datagram, length, time::systemTime());
+	}
+}
+
+/* PeriodicObserver::HandlerProtocol */ void TimeSync::handlePeriodicEvent(uint32_t count, PeriodicObserver::PeriodUnit /* unit */)
+{
+	uint32_t remainingCount = mNextCount - count;
+	if((mNextCount != 0) && (remainingCount <= (uint32_t) INT32_MAX)) {
+		return;	// the next count is not reached
+	}
+
+	mNextCount = count + ((mSampleCount < kSampleCount) ? kRequestIntervalFast : kRequestIntervalSlow);
+	sendRequest();
+}
+
+void TimeSync::sendRequest()
+{
+	uint8_t request[kRequestSize];
+	request[0] = 0;
+	request[1] = kFlagsRequest;
+	request[2] = ++mSequence;
+	putLong(&request[3], time::systemTime());
+	radio::send(request, kRequestSize);
+}
+
+void TimeSync::handleRequest(const uint8_t* datagram, int /* length */, time::NetworkTime receivedTime)
+{
+	uint8_t response[kResponseSize];
+	response[0] = 0;
+	response[1] = kFlagsResponse;
+	response[2] = datagram[2];
+	memcpy(&response[3], &datagram[3], 4);	// echo T1
+	putLong(&response[7], receivedTime);
+	putLong(&response[11], time::networkTime());
+	radio::send(response, kResponseSize);
+}
+
+void TimeSync::handleResponse(const uint8_t* datagram, int length, time::SystemTime receivedTime)
+{
+	if((length < kResponseSize) || (datagram[2] != mSequence)) {
+		return;	// invalid or stale response
+	}
+
+	uint32_t t1 = getLong(&datagram[3]);
+	uint32_t t2 = getLong(&datagram[7]);
+	uint32_t t3 = getLong(&datagram[11]);
+	uint32_t t4 = receivedTime;
+
+	int32_t roundTrip = (int32_t) (t4 - t1) - (int32_t) (t3 - t2);
+	if((roundTrip < 0) || (kRoundTripMax < roundTrip)) {
+		return;	// too late to be useful
+	}
+
+	Sample sample;
+	sample.localTime = receivedTime;
+	sample.offset = ((int32_t) (t2 - t1) + (int32_t) (t3 - t4)) / 2;
+	sample.roundTrip = roundTrip;
+	Statistics::setItem(sStatisticsRoundTrip, sample.roundTrip);
+	addSample(sample);
+}
+
+void TimeSync::addSample(const Sample& sample)
+{
+	mSamples[mSampleNext] = sample;
+	mSampleNext = (mSampleNext + 1) % kSampleCount;
+	if(mSampleCount < kSampleCount) {
+		mSampleCount++;
+	}
+
+	// Select the sample with the shortest round trip, which has the smallest error
+	const Sample* best = &mSamples[0];
+	for(int i = 1; i < mSampleCount; i++) {
+		if(mSamples[i].roundTrip < best->roundTrip) {
+			best = &mSamples[i];
+		}
+	}
+
+	// Estimate the drift from the best samples apart enough
+	if(mDriftReferenceTime == 0) {
+		mDriftReferenceTime = best->localTime;
+		mDriftReferenceOffset = best->offset;
+	}
+	else if((int32_t) kDriftIntervalMin <= (int32_t) (best->localTime - mDriftReferenceTime)) {
+		int64_t drift = (int64_t) (best->offset - mDriftReferenceOffset) * 1000000 / (int32_t) (best->localTime - mDriftReferenceTime);
+		if(drift < -kDriftMax) {
+			drift = -kDriftMax;
+		}
+		else if(kDriftMax < drift) {
+			drift = kDriftMax;
+		}
+		mDrift = (mDrift * 3 + (int32_t) drift) / 4;
+		mDriftReferenceTime = best->localTime;
+		mDriftReferenceOffset = best->offset;
+		Statistics::setItem(sStatisticsDrift, (mDrift < 0) ? -mDrift : mDrift);
+	}
+
+	time::setNetworkTimeEstimate(best->localTime, best->offset, mDrift);
+
+	// The error is bounded by the half of the round trip, plus the resolution of the System Time
+	mAccuracy = best->roundTrip / 2 + 1;
+	Statistics::setItem(sStatisticsAccuracy, mAccuracy);
+}
+
+}	// microbit_dal_ext_kit
@@ -0,0 +1,133 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Trace utility
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#include "ExtKitTrace.h"	// self
+#include "ExtKit.h"
+
+namespace microbit_dal_ext_kit {
+namespace trace {
+
+//																 123456789abcdef012345
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sRecorded,		"\x15", "Trace Recorded:      ")
+EXT_KIT_DEFINE_LITERAL_MANAGED_STRING(static const, sOverwritten,	"\x15", "Trace Overwritten:   ")
+
+/// Trace Buffer Size in bytes. The disabled buffer has 1 byte, which is smaller than any record.
+static const size_t kBufferSize = (0 < EXT_KIT_CONFIG_VALUE(TRACE_BUFFER)) ? EXT_KIT_CONFIG_VALUE(TRACE_BUFFER) : 1;
+
+/// Trace Buffer as a ring buffer
+static uint8_t	sBuffer[kBufferSize];
+
+/// Index of the oldest record
+static size_t	sHead = 0;
+
+/// Number of bytes recorded
+static size_t	sLength = 0;
+
+/// Number of records since the last sendRecords()
+static uint16_t	sRecordedCount = 0;
+
+/// Number of records overwritten or dropped since the last sendRecords()
+static uint16_t	sOverwrittenCount = 0;
+
+/// Whether the records are being sent or not
+static bool		sSending = false;
+
+static void storeLittleEndian(uint8_t* p, uint32_t value);
+static void reverse(size_t start, size_t end);
+
+void record(uint32_t id, const uint32_t* args, int argCount)
+{
+	size_t size = kRecordHeaderSize + argCount * 4;
+	if(kBufferSize < size) {
+		return;
+	}
+
+	// Overwrite the oldest records, or drop the new record while the oldest ones are being sent
+	if(sSending && (kBufferSize - sLength < size)) {
+		sOverwrittenCount++;
+		return;
+	}
+	while(kBufferSize - sLength < size) {
+		size_t oldestSize = kRecordHeaderSize + sBuffer[(sHead + 1) % kBufferSize] * 4;
+		sHead = (sHead + oldestSize) % kBufferSize;
+		sLength -= oldestSize;
+		sOverwrittenCount++;
+	}
+
+	uint8_t record[kRecordHeaderSize + kArgCountMax * 4];
+	record[0] = kRecordSync;
+	record[1] = argCount;
+	storeLittleEndian(&record[2], id);
+	storeLittleEndian(&record[6], time::microTime());
+	for(int i = 0; i < argCount; i++) {
+		storeLittleEndian(&record[kRecordHeaderSize + i * 4], args[i]);
+	}
+
+	size_t tail = (sHead + sLength) % kBufferSize;
+	for(size_t i = 0; i < size; i++) {
+		sBuffer[tail] = record[i];
+		tail = (tail + 1 == kBufferSize) ? 0 : tail + 1;
+	}
+	sLength += size;
+	sRecordedCount++;
+}
+
+void sendRecords()
+{
+	Statistics::setItem(sRecorded, sRecordedCount);
+	Statistics::setItem(sOverwritten, sOverwrittenCount);
+	sRecordedCount = 0;
+	sOverwrittenCount = 0;
+	if(!sLength) {
+		return;
+	}
+
+	// Rotate the ring buffer in place, so that the records are contiguous from the beginning
+	if(sHead) {
+		reverse(0, sHead);
+		reverse(sHead, kBufferSize);
+		reverse(0, kBufferSize);
+		sHead = 0;
+	}
+
+	// The records may be added while sending them
+	size_t length = sLength;
+	sSending = true;
+	serial::sendBinary(sBuffer, length);
+	sSending = false;
+	sHead = length % kBufferSize;
+	sLength -= length;
+}
+
+size_t bufferedSize()
+{
+	return sLength;
+}
+
+void storeLittleEndian(uint8_t* p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+void reverse(size_t start, size_t end)
+{
+	while((start + 1) < end) {
+		uint8_t c = sBuffer[start];
+		sBuffer[start++] = sBuffer[--end];
+		sBuffer[end] = c;
+	}
+}
+
+}	// trace
+}	// microbit_dal_ext_kit
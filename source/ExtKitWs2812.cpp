@@ -0,0 +1,62 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// WS2812 utility
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+*/
+
+#include "ExtKitWs2812.h"	// self
+#include "ExtKit.h"
+
+namespace microbit_dal_ext_kit {
+namespace ws2812 {
+
+size_t encodeForSpi3(const uint8_t* src, size_t len, uint8_t* /* OUT */ dst)
+{
+	for(size_t i = 0; i < len; i++) {
+		uint8_t byte = *src++;
+		uint32_t symbols = 0;	// 24 bits for 8 data bits
+		for(int bit = 0; bit < 8; bit++) {
+			symbols <<= kSpi3SymbolsPerBit;
+			symbols |= (byte & 0x80) ? 0x6 /* 110 */ : 0x4 /* 100 */;
+			byte <<= 1;
+		}
+		*dst++ = (uint8_t) (symbols >> 16);
+		*dst++ = (uint8_t) (symbols >> 8);
+		*dst++ = (uint8_t) symbols;
+	}
+	return len * kSpi3SymbolsPerBit;
+}
+
+size_t encodeForSpi4(const uint8_t* src, size_t len, uint8_t* /* OUT */ dst)
+{
+	for(size_t i = 0; i < len; i++) {
+		uint8_t byte = *src++;
+		for(int bit = 0; bit < 8; bit += 2) {
+			uint8_t hi = (byte & 0x80) ? 0xE /* 1110 */ : 0x8 /* 1000 */;
+			uint8_t lo = (byte & 0x40) ? 0xE /* 1110 */ : 0x8 /* 1000 */;
+			*dst++ = (hi << 4) | lo;
+			byte <<= 2;
+		}
+	}
+	return len * kSpi4SymbolsPerBit;
+}
+
+size_t encodeForPwm(const uint8_t* src, size_t len, uint16_t* /* OUT */ dst, uint16_t dutyFor0, uint16_t dutyFor1)
+{
+	for(size_t i = 0; i < len; i++) {
+		uint8_t byte = *src++;
+		for(int bit = 0; bit < 8; bit++) {
+			*dst++ = (byte & 0x80) ? dutyFor1 : dutyFor0;
+			byte <<= 1;
+		}
+	}
+	return len * 8;
+}
+
+}	// ws2812
+}	// microbit_dal_ext_kit
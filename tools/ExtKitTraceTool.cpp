@@ -0,0 +1,345 @@
+/// The set of components and utilities for C++ applications using `microbit-dal` (also known as micro:bit runtime)
+/**	@package	microbit_dal_ext_kit
+*/
+
+/// Host tool for the trace records sent by `trace::sendRecords()`
+/**	@file
+	@author	Copyright (c) 2019 Tomoyuki Nakashima.<br>
+			This code is licensed under MIT license. See `LICENSE` in the project root for more information.
+	@note	Run Doxygen (http://www.doxygen.nl) with `Doxyfile` in the project root to generate the documentation.
+
+	This tool runs on the host, not on the device. Build it in the project root as follows.
+	@code
+		g++ -std=c++11 -Iinc -o ext-kit-trace tools/ExtKitTraceTool.cpp
+	@endcode
+
+	Generate the string table from the sources using `EXT_KIT_TRACE()`.
+	@code
+		./ext-kit-trace table $(find source -name '*.cpp') > trace-table.txt
+	@endcode
+
+	Decode a byte stream captured from the serial port, e.g., with `cat /dev/ttyACM0 > capture.bin` while sending the `:tr` command.
+	The text output in the stream is passed through, and each record is replaced with its formatted message.
+	@code
+		./ext-kit-trace decode trace-table.txt capture.bin
+	@endcode
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "ExtKitTrace.h"
+
+using namespace microbit_dal_ext_kit;
+
+/// Log Site in the string table
+struct LogSite
+{
+	/// Locations as "file:line", separated by spaces
+	std::string	locations;
+
+	/// Format string
+	std::string	format;
+};
+
+/// String Table
+typedef std::map<uint32_t, LogSite>	StringTable;
+
+static bool readFile(const char* path, std::string& /* OUT */ content);
+static bool parseStringLiterals(const std::string& source, size_t& /* INOUT */ pos, std::string& /* OUT */ value);
+static std::string escape(const std::string& s);
+static std::string unescape(const std::string& s);
+static int generateTable(int fileCount, char** files);
+static bool readTable(const char* path, StringTable& /* OUT */ table);
+static std::string formatRecord(const std::string& format, const uint32_t* args, int argCount);
+static uint32_t loadLittleEndian(const uint8_t* p);
+static int decode(const char* tablePath, const char* capturePath);
+
+int main(int argc, char** argv)
+{
+	if((3 <= argc) && (strcmp(argv[1], "table") == 0)) {
+		return generateTable(argc - 2, &argv[2]);
+	}
+	else if(((argc == 3) || (argc == 4)) && (strcmp(argv[1], "decode") == 0)) {
+		return decode(argv[2], (argc == 4) ? argv[3] : 0);
+	}
+
+	fprintf(stderr, "usage: %s table <source>...\n", argv[0]);
+	fprintf(stderr, "       %s decode <table> [<capture>]\n", argv[0]);
+	return 2;
+}
+
+bool readFile(const char* path, std::string& /* OUT */ content)
+{
+	std::ifstream in(path, std::ios::binary);
+	if(!in) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return false;
+	}
+	content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	return true;
+}
+
+bool parseStringLiterals(const std::string& source, size_t& /* INOUT */ pos, std::string& /* OUT */ value)
+{
+	// Concatenate the adjacent string literals in the same way as the compiler
+	bool found = false;
+	value.clear();
+	while(true) {
+		while((pos < source.size()) && isspace((unsigned char) source[pos])) {
+			pos++;
+		}
+		if((source.size() <= pos) || (source[pos] != '"')) {
+			return found;
+		}
+		size_t end = ++pos;
+		while((end < source.size()) && (source[end] != '"')) {
+			end += (source[end] == '\\') ? 2 : 1;
+		}
+		if(source.size() <= end) {
+			return false;
+		}
+		value += unescape(source.substr(pos, end - pos));
+		pos = end + 1;
+		found = true;
+	}
+}
+
+std::string escape(const std::string& s)
+{
+	std::string t;
+	for(size_t i = 0; i < s.size(); i++) {
+		unsigned char c = s[i];
+		switch(c) {
+		case '\t':	t += "\\t";		break;
+		case '\n':	t += "\\n";		break;
+		case '\r':	t += "\\r";		break;
+		case '\\':	t += "\\\\";	break;
+		default:
+			if((c < 0x20) || (0x7f <= c)) {
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\x%02x", c);
+				t += buf;
+			}
+			else {
+				t += c;
+			}
+			break;
+		}
+	}
+	return t;
+}
+
+std::string unescape(const std::string& s)
+{
+	std::string t;
+	for(size_t i = 0; i < s.size(); i++) {
+		char c = s[i];
+		if((c != '\\') || (s.size() <= i + 1)) {
+			t += c;
+			continue;
+		}
+		c = s[++i];
+		switch(c) {
+		case 't':	t += '\t';	break;
+		case 'n':	t += '\n';	break;
+		case 'r':	t += '\r';	break;
+		case '0':	t += '\0';	break;
+		case 'x': {
+			unsigned int value = 0;
+			while((i + 1 < s.size()) && isxdigit((unsigned char) s[i + 1])) {
+				char h = s[++i];
+				value = value * 16 + (isdigit((unsigned char) h) ? h - '0' : (tolower(h) - 'a' + 10));
+			}
+			t += (char) value;
+			break;
+		}
+		default:	// including '\\', '"' and '\''
+			t += c;
+			break;
+		}
+	}
+	return t;
+}
+
+int generateTable(int fileCount, char** files)
+{
+	static const char kMacro[] = "EXT_KIT_TRACE(";
+
+	StringTable table;
+	for(int i = 0; i < fileCount; i++) {
+		std::string source;
+		if(!readFile(files[i], source)) {
+			return 1;
+		}
+
+		size_t pos = 0;
+		while((pos = source.find(kMacro, pos)) != std::string::npos) {
+			int line = 1 + std::count(source.begin(), source.begin() + pos, '\n');
+			pos += sizeof(kMacro) - 1;
+
+			std::string format;
+			if(!parseStringLiterals(source, pos, format)) {
+				continue;	// the definition of the macro or a format which is not a string literal
+			}
+
+			uint32_t id = trace::idForFormat(format.c_str());
+			std::ostringstream location;
+			location << files[i] << ':' << line;
+			LogSite& site = table[id];
+			if(site.locations.empty()) {
+				site.format = format;
+			}
+			else if(site.format != format) {
+				fprintf(stderr, "%s: id %08x collides with \"%s\"\n", location.str().c_str(), id, escape(site.format).c_str());
+				continue;
+			}
+			else {
+				site.locations += ' ';
+			}
+			site.locations += location.str();
+		}
+	}
+
+	for(StringTable::const_iterator it = table.begin(); it != table.end(); ++it) {
+		printf("%08x\t%s\t%s\n", it->first, it->second.locations.c_str(), escape(it->second.format).c_str());
+	}
+	return 0;
+}
+
+bool readTable(const char* path, StringTable& /* OUT */ table)
+{
+	std::string content;
+	if(!readFile(path, content)) {
+		return false;
+	}
+
+	std::istringstream in(content);
+	std::string line;
+	while(std::getline(in, line)) {
+		size_t tab1 = line.find('\t');
+		size_t tab2 = (tab1 == std::string::npos) ? tab1 : line.find('\t', tab1 + 1);
+		if(tab2 == std::string::npos) {
+			continue;
+		}
+		LogSite& site = table[(uint32_t) strtoul(line.substr(0, tab1).c_str(), 0, 16)];
+		site.locations = line.substr(tab1 + 1, tab2 - tab1 - 1);
+		site.format = unescape(line.substr(tab2 + 1));
+	}
+	return true;
+}
+
+std::string formatRecord(const std::string& format, const uint32_t* args, int argCount)
+{
+	// Format each conversion with printf(), which supports all the conversions of string::format()
+	std::string message;
+	int argIndex = 0;
+	for(size_t i = 0; i < format.size(); i++) {
+		if(format[i] != '%') {
+			message += format[i];
+			continue;
+		}
+
+		size_t end = i + 1;
+		while((end < format.size()) && strchr("-0123456789", format[end])) {
+			end++;
+		}
+		if(format.size() <= end) {
+			message += format.substr(i);
+			break;
+		}
+
+		char conversion = format[end];
+		std::string spec = format.substr(i, end - i);
+		char buf[64];
+		if(conversion == '%') {
+			snprintf(buf, sizeof(buf), "%%");
+		}
+		else if(argCount <= argIndex) {
+			snprintf(buf, sizeof(buf), "<missing>");
+		}
+		else if(conversion == 'd') {
+			snprintf(buf, sizeof(buf), (spec + "d").c_str(), (int32_t) args[argIndex++]);
+		}
+		else if(strchr("uxX", conversion)) {
+			snprintf(buf, sizeof(buf), (spec + conversion).c_str(), args[argIndex++]);
+		}
+		else if(conversion == 'c') {
+			snprintf(buf, sizeof(buf), (spec + "c").c_str(), (char) args[argIndex++]);
+		}
+		else {	// including 's', which is recorded as a pointer
+			snprintf(buf, sizeof(buf), "0x%08x", args[argIndex++]);
+		}
+		message += buf;
+		i = end;
+	}
+	return message;
+}
+
+uint32_t loadLittleEndian(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+int decode(const char* tablePath, const char* capturePath)
+{
+	StringTable table;
+	if(!readTable(tablePath, table)) {
+		return 1;
+	}
+
+	std::string capture;
+	if(capturePath) {
+		if(!readFile(capturePath, capture)) {
+			return 1;
+		}
+	}
+	else {
+		capture.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+	}
+
+	const uint8_t* p = (const uint8_t*) capture.data();
+	size_t size = capture.size();
+	int unknownCount = 0;
+	for(size_t i = 0; i < size; ) {
+		if(p[i] != trace::kRecordSync) {
+			putchar(p[i++]);	// text output
+			continue;
+		}
+
+		// Resynchronize at the next byte unless the record is complete and its id is known
+		int argCount = (i + 1 < size) ? p[i + 1] : 0;
+		size_t recordSize = trace::kRecordHeaderSize + argCount * 4;
+		StringTable::const_iterator it = table.end();
+		if((argCount <= trace::kArgCountMax) && (i + recordSize <= size)) {
+			it = table.find(loadLittleEndian(&p[i + 2]));
+		}
+		if(it == table.end()) {
+			unknownCount++;
+			i++;
+			continue;
+		}
+
+		uint32_t args[trace::kArgCountMax];
+		for(int n = 0; n < argCount; n++) {
+			args[n] = loadLittleEndian(&p[i + trace::kRecordHeaderSize + n * 4]);
+		}
+		uint32_t microTime = loadLittleEndian(&p[i + 6]);
+		printf("[TRACE] %u.%06u %s\t%s\n", microTime / 1000000, microTime % 1000000, formatRecord(it->second.format, args, argCount).c_str(), it->second.locations.c_str());
+		i += recordSize;
+	}
+
+	if(unknownCount) {
+		fprintf(stderr, "%d sync bytes without a known record are skipped\n", unknownCount);
+	}
+	return 0;
+}